@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks explicit synchronization end to end with sw_sync fences, entirely
+// in-process and without any GPU involvement: the client commits a
+// wpe_dmabuf_pool buffer along with an acquire fence and a release request,
+// the embedder (this program) checks that wpe_dmabuf_pool_entry_get_acquire_fence()
+// hands out that very fence and releases the entry with a fence of its own,
+// which then has to reach the client through fenced_release.
+//
+// Fences are told apart by signaling their timeline: a fence must be pending
+// when received, and signaled right after its timeline is advanced. Needs a
+// kernel built with CONFIG_SW_SYNC and access to its debugfs interface.
+
+#include "../src/ws-client.h"
+#include "../src/ws.h"
+#include <wpe/fdo.h>
+#include <wpe/unstable/fdo-dmabuf.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <linux/types.h>
+#include <memory>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The sw_sync interface is not part of the kernel UAPI headers.
+struct sw_sync_create_fence_data {
+    __u32 value;
+    char name[32];
+    __s32 fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE _IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, __u32)
+
+namespace {
+
+// DRM_FORMAT_XRGB8888, without depending on libdrm for a single constant.
+static const uint32_t s_entryFormat = 0x34325258;
+
+class Timeline {
+public:
+    Timeline()
+    {
+        for (const char* path : { "/sys/kernel/debug/sync/sw_sync", "/dev/sw_sync" }) {
+            m_fd = open(path, O_RDWR | O_CLOEXEC);
+            if (m_fd != -1)
+                break;
+        }
+    }
+
+    ~Timeline()
+    {
+        if (m_fd != -1)
+            close(m_fd);
+    }
+
+    bool isValid() const { return m_fd != -1; }
+
+    // Returns a sync_file which signals on the next call to advance().
+    int createFence(const char* name)
+    {
+        struct sw_sync_create_fence_data data;
+        std::memset(&data, 0, sizeof(data));
+        data.value = m_value + 1;
+        std::strncpy(data.name, name, sizeof(data.name) - 1);
+        if (ioctl(m_fd, SW_SYNC_IOC_CREATE_FENCE, &data) == -1)
+            return -1;
+        return data.fence;
+    }
+
+    bool advance()
+    {
+        __u32 increment = 1;
+        if (ioctl(m_fd, SW_SYNC_IOC_INC, &increment) == -1)
+            return false;
+        ++m_value;
+        return true;
+    }
+
+private:
+    int m_fd { -1 };
+    uint32_t m_value { 0 };
+};
+
+static bool isSignaled(int fence)
+{
+    struct pollfd pollFD = { fence, POLLIN, 0 };
+    return poll(&pollFD, 1, 0) == 1;
+}
+
+// Whether the fence belongs to the timeline: pending now, signaled once the
+// timeline is advanced.
+static bool fenceBelongsTo(int fence, Timeline& timeline)
+{
+    return fence != -1 && !isSignaled(fence) && timeline.advance() && isSignaled(fence);
+}
+
+class Client final : public WS::BaseTarget, public WS::BaseTarget::Impl {
+public:
+    class Backend final : public WS::BaseBackend {
+    public:
+        explicit Backend(int hostFD)
+            : WS::BaseBackend(hostFD)
+        {
+        }
+    };
+
+    class Observer {
+    public:
+        virtual ~Observer() = default;
+
+        virtual void bufferReleased(int releaseFence) = 0;
+    };
+
+    Client(Backend& backend, int targetFD, uint32_t width, uint32_t height, Observer& observer)
+        : WS::BaseTarget(targetFD, *this)
+        , m_observer(observer)
+        , m_width(width)
+        , m_height(height)
+    {
+        WS::BaseTarget::initialize(backend);
+    }
+
+    ~Client()
+    {
+        g_clear_pointer(&m_release, zwp_linux_buffer_release_v1_destroy);
+        g_clear_pointer(&m_buffer, wl_buffer_destroy);
+    }
+
+    bool isSupported() const { return wpeDmabufPool() && surfaceSynchronization(); }
+
+    // Takes ownership of the fence.
+    void commit(int acquireFence)
+    {
+        m_buffer = wpe_dmabuf_pool_create_buffer(wpeDmabufPool(), m_width, m_height);
+
+        zwp_linux_surface_synchronization_v1_set_acquire_fence(surfaceSynchronization(), acquireFence);
+        close(acquireFence);
+        m_release = zwp_linux_surface_synchronization_v1_get_release(surfaceSynchronization());
+        zwp_linux_buffer_release_v1_add_listener(m_release, &s_bufferReleaseListener, this);
+
+        wl_surface_attach(surface(), m_buffer, 0, 0);
+        wl_surface_damage(surface(), 0, 0, m_width, m_height);
+        wl_surface_commit(surface());
+        wl_display_flush(display());
+    }
+
+private:
+    // WS::BaseTarget::Impl
+    void dispatchFrameComplete() override { }
+    void dispatchTrimMemory(WS::TrimMemoryLevel) override { }
+
+    static const struct zwp_linux_buffer_release_v1_listener s_bufferReleaseListener;
+
+    Observer& m_observer;
+    uint32_t m_width;
+    uint32_t m_height;
+    struct wl_buffer* m_buffer { nullptr };
+    struct zwp_linux_buffer_release_v1* m_release { nullptr };
+};
+
+const struct zwp_linux_buffer_release_v1_listener Client::s_bufferReleaseListener = {
+    // fenced_release
+    [](void* data, struct zwp_linux_buffer_release_v1*, int32_t fence)
+    {
+        auto& client = *static_cast<Client*>(data);
+        g_clear_pointer(&client.m_release, zwp_linux_buffer_release_v1_destroy);
+        client.m_observer.bufferReleased(fence);
+    },
+    // immediate_release
+    [](void* data, struct zwp_linux_buffer_release_v1*)
+    {
+        auto& client = *static_cast<Client*>(data);
+        g_clear_pointer(&client.m_release, zwp_linux_buffer_release_v1_destroy);
+        client.m_observer.bufferReleased(-1);
+    },
+};
+
+struct Options {
+    gint width { 64 };
+    gint height { 64 };
+    gint timeout { 5 };
+};
+
+class Check final : public Client::Observer {
+public:
+    explicit Check(const Options& options)
+        : m_options(options)
+    {
+        m_host.context = g_main_context_default();
+        m_host.loop = g_main_loop_new(m_host.context, FALSE);
+    }
+
+    ~Check()
+    {
+        g_main_loop_unref(m_host.loop);
+    }
+
+    bool run()
+    {
+        if (!m_acquireTimeline.isValid() || !m_releaseTimeline.isValid()) {
+            std::fprintf(stderr, "sw_sync is not available: %s\n", std::strerror(errno));
+            return false;
+        }
+
+        if (!wpe_fdo_initialize_dmabuf()) {
+            std::fprintf(stderr, "Failed to initialize the dma-buf pool nested compositor\n");
+            return false;
+        }
+
+        static const struct wpe_view_backend_dmabuf_pool_fdo_client s_dmabufPoolClient = {
+            // create_entry
+            [](void* data) -> struct wpe_dmabuf_pool_entry*
+            {
+                return static_cast<Check*>(data)->createEntry();
+            },
+            // destroy_entry
+            [](void*, struct wpe_dmabuf_pool_entry* entry)
+            {
+                close(GPOINTER_TO_INT(wpe_dmabuf_pool_entry_get_user_data(entry)));
+                wpe_dmabuf_pool_entry_destroy(entry);
+            },
+            // commit_entry
+            [](void* data, struct wpe_dmabuf_pool_entry* entry)
+            {
+                static_cast<Check*>(data)->commitEntry(entry);
+            },
+            nullptr,
+            nullptr,
+            nullptr,
+            nullptr,
+        };
+
+        m_host.exportable = wpe_view_backend_dmabuf_pool_fdo_create(&s_dmabufPoolClient, this, m_options.width, m_options.height);
+        struct wpe_view_backend* viewBackend = wpe_view_backend_dmabuf_pool_fdo_get_view_backend(m_host.exportable);
+        wpe_view_backend_initialize(viewBackend);
+
+        m_client.backendFD = WS::Instance::singleton().createClient();
+        m_client.targetFD = wpe_view_backend_get_renderer_host_fd(viewBackend);
+        if (m_client.backendFD == -1 || m_client.targetFD == -1) {
+            std::fprintf(stderr, "Failed to create the client connections\n");
+            return false;
+        }
+
+        m_client.thread = g_thread_new("check-client", s_clientThread, this);
+        g_main_loop_run(m_host.loop);
+        g_thread_join(m_client.thread);
+
+        wpe_view_backend_dmabuf_pool_fdo_destroy(m_host.exportable);
+
+        return report();
+    }
+
+private:
+    // Host side, runs on the main thread.
+    struct wpe_dmabuf_pool_entry* createEntry()
+    {
+        // Nothing ever reads the buffer, any shareable memory will do.
+        int fd = memfd_create("WPEBackend-fdo::check", MFD_CLOEXEC);
+        uint32_t stride = m_options.width * 4;
+        if (fd == -1 || ftruncate(fd, stride * m_options.height) == -1) {
+            std::fprintf(stderr, "Failed to allocate the entry\n");
+            if (fd != -1)
+                close(fd);
+            return nullptr;
+        }
+
+        struct wpe_dmabuf_pool_entry_init init;
+        std::memset(&init, 0, sizeof(init));
+        init.width = m_options.width;
+        init.height = m_options.height;
+        init.format = s_entryFormat;
+        init.num_planes = 1;
+        init.fds[0] = fd;
+        init.strides[0] = stride;
+
+        struct wpe_dmabuf_pool_entry* entry = wpe_dmabuf_pool_entry_create(&init);
+        wpe_dmabuf_pool_entry_set_user_data(entry, GINT_TO_POINTER(fd));
+        return entry;
+    }
+
+    void commitEntry(struct wpe_dmabuf_pool_entry* entry)
+    {
+        m_result.acquireFenceReceived = wpe_dmabuf_pool_entry_get_acquire_fence(entry) != -1;
+        m_result.acquireFenceMatches = fenceBelongsTo(wpe_dmabuf_pool_entry_get_acquire_fence(entry), m_acquireTimeline);
+
+        wpe_view_backend_dmabuf_pool_fdo_dispatch_release_entry_with_fence(m_host.exportable, entry,
+            m_releaseTimeline.createFence("release"));
+        wpe_view_backend_dmabuf_pool_fdo_dispatch_frame_complete(m_host.exportable);
+    }
+
+    // Client::Observer, runs on the client thread.
+    void bufferReleased(int releaseFence) override
+    {
+        m_result.releaseFenceReceived = releaseFence != -1;
+        m_result.releaseFenceMatches = fenceBelongsTo(releaseFence, m_releaseTimeline);
+        if (releaseFence != -1)
+            close(releaseFence);
+
+        g_main_loop_quit(m_client.loop);
+    }
+
+    static gpointer s_clientThread(gpointer data)
+    {
+        auto& check = *static_cast<Check*>(data);
+        auto& client = check.m_client;
+
+        GMainContext* context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        client.loop = g_main_loop_new(context, FALSE);
+
+        client.backend.reset(new Client::Backend(client.backendFD));
+        client.client.reset(new Client(*client.backend, client.targetFD, check.m_options.width, check.m_options.height, check));
+
+        if (!client.client->isSupported()) {
+            std::fprintf(stderr, "The host does not support explicit synchronization of dma-buf pool buffers\n");
+            g_main_loop_quit(client.loop);
+        } else {
+            int fence = check.m_acquireTimeline.createFence("acquire");
+            if (fence == -1) {
+                std::fprintf(stderr, "Failed to create the acquire fence: %s\n", std::strerror(errno));
+                g_main_loop_quit(client.loop);
+            } else
+                client.client->commit(fence);
+        }
+
+        GSource* timeout = g_timeout_source_new_seconds(check.m_options.timeout);
+        g_source_set_callback(timeout,
+            [](gpointer data) -> gboolean {
+                auto& check = *static_cast<Check*>(data);
+                check.m_result.timedOut = true;
+                g_main_loop_quit(check.m_client.loop);
+                return G_SOURCE_REMOVE;
+            }, &check, nullptr);
+        g_source_attach(timeout, context);
+
+        g_main_loop_run(client.loop);
+
+        g_source_destroy(timeout);
+        g_source_unref(timeout);
+
+        client.client = nullptr;
+        client.backend = nullptr;
+        g_main_loop_unref(client.loop);
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+
+        g_main_context_invoke(check.m_host.context,
+            [](gpointer data) -> gboolean {
+                g_main_loop_quit(static_cast<Check*>(data)->m_host.loop);
+                return G_SOURCE_REMOVE;
+            }, &check);
+        return nullptr;
+    }
+
+    bool report()
+    {
+        auto print = [](const char* name, bool passed) {
+            std::printf("  %-40s %s\n", name, passed ? "ok" : "FAILED");
+            return passed;
+        };
+
+        std::printf("bench-explicit-sync:\n");
+        bool passed = print("acquire fence reaches the embedder", m_result.acquireFenceReceived);
+        passed &= print("acquire fence is the committed one", m_result.acquireFenceMatches);
+        passed &= print("release fence reaches the client", m_result.releaseFenceReceived);
+        passed &= print("release fence is the embedder's one", m_result.releaseFenceMatches);
+        if (m_result.timedOut)
+            std::printf("  timed out after %d seconds\n", m_options.timeout);
+        return passed;
+    }
+
+    Options m_options;
+    Timeline m_acquireTimeline;
+    Timeline m_releaseTimeline;
+
+    // Written on one thread, read on the other once it is joined.
+    struct {
+        std::atomic<bool> acquireFenceReceived { false };
+        std::atomic<bool> acquireFenceMatches { false };
+        std::atomic<bool> releaseFenceReceived { false };
+        std::atomic<bool> releaseFenceMatches { false };
+        std::atomic<bool> timedOut { false };
+    } m_result;
+
+    struct {
+        GMainContext* context { nullptr };
+        GMainLoop* loop { nullptr };
+        struct wpe_view_backend_dmabuf_pool_fdo* exportable { nullptr };
+    } m_host;
+
+    struct {
+        int backendFD { -1 };
+        int targetFD { -1 };
+        GThread* thread { nullptr };
+        GMainLoop* loop { nullptr };
+        std::unique_ptr<Client::Backend> backend;
+        std::unique_ptr<Client> client;
+    } m_client;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry entries[] = {
+        { "width", 0, 0, G_OPTION_ARG_INT, &options.width, "Buffer width", "PIXELS" },
+        { "height", 0, 0, G_OPTION_ARG_INT, &options.height, "Buffer height", "PIXELS" },
+        { "timeout", 't', 0, G_OPTION_ARG_INT, &options.timeout, "Seconds to wait for the release", "SECONDS" },
+        { nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr },
+    };
+
+    GError* error = nullptr;
+    GOptionContext* context = g_option_context_new("- check explicit synchronization with sw_sync fences");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (options.width <= 0 || options.height <= 0 || options.timeout <= 0) {
+        std::fprintf(stderr, "Invalid options\n");
+        return EXIT_FAILURE;
+    }
+
+    Check check(options);
+    return check.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
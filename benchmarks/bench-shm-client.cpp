@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bench-shm-client.h"
+
+#include "../src/ws-client.h"
+#include <array>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Bench {
+
+class ShmClient::Backend final : public WS::BaseBackend {
+public:
+    explicit Backend(int hostFD)
+        : WS::BaseBackend(hostFD)
+    {
+    }
+};
+
+class ShmClient::Private final : public WS::BaseTarget, public WS::BaseTarget::Impl {
+public:
+    Private(Backend& backend, int targetFD, uint32_t width, uint32_t height, Observer& observer)
+        : WS::BaseTarget(targetFD, *this)
+        , m_observer(observer)
+        , m_width(width)
+        , m_height(height)
+    {
+        WS::BaseTarget::initialize(backend);
+
+        if (!shm())
+            g_error("ShmClient: the host does not support wl_shm");
+
+        m_stride = m_width * 4;
+        m_size = size_t(m_stride) * m_height * m_buffers.size();
+
+        int fd = memfd_create("WPEBackend-fdo::bench", MFD_CLOEXEC);
+        if (fd == -1 || ftruncate(fd, m_size) == -1)
+            g_error("ShmClient: failed to allocate %zu bytes of shared memory", m_size);
+
+        m_data = static_cast<uint8_t*>(mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (m_data == MAP_FAILED)
+            g_error("ShmClient: failed to map shared memory");
+
+        struct wl_shm_pool* pool = wl_shm_create_pool(shm(), fd, m_size);
+        for (unsigned i = 0; i < m_buffers.size(); ++i) {
+            auto& buffer = m_buffers[i];
+            buffer.target = this;
+            buffer.offset = i * m_stride * m_height;
+            buffer.buffer = wl_shm_pool_create_buffer(pool, buffer.offset, m_width, m_height, m_stride, WL_SHM_FORMAT_ARGB8888);
+            wl_buffer_add_listener(buffer.buffer, &s_bufferListener, &buffer);
+        }
+        wl_shm_pool_destroy(pool);
+        close(fd);
+    }
+
+    ~Private()
+    {
+        for (auto& buffer : m_buffers)
+            g_clear_pointer(&buffer.buffer, wl_buffer_destroy);
+
+        if (m_data && m_data != MAP_FAILED)
+            munmap(m_data, m_size);
+    }
+
+    void renderFrame()
+    {
+        Buffer* buffer = nullptr;
+        for (auto& b : m_buffers) {
+            if (!b.busy) {
+                buffer = &b;
+                break;
+            }
+        }
+
+        if (!buffer) {
+            m_framePending = true;
+            return;
+        }
+        m_framePending = false;
+
+        uint64_t frame = m_frameCount++;
+        std::memset(m_data + buffer->offset, frame & 0xff, size_t(m_stride) * m_height);
+
+        buffer->busy = true;
+        buffer->frame = frame;
+        m_currentFrame = frame;
+
+        m_observer.frameCommitted(frame);
+
+        requestFrame();
+        wl_surface_attach(surface(), buffer->buffer, 0, 0);
+        wl_surface_damage(surface(), 0, 0, m_width, m_height);
+        wl_surface_commit(surface());
+        wl_display_flush(display());
+    }
+
+    uint64_t framesCommitted() const { return m_frameCount; }
+
+private:
+    struct Buffer {
+        Private* target { nullptr };
+        struct wl_buffer* buffer { nullptr };
+        uint32_t offset { 0 };
+        uint64_t frame { 0 };
+        bool busy { false };
+    };
+
+    // WS::BaseTarget::Impl
+    void dispatchFrameComplete() override
+    {
+        m_observer.frameDone(m_currentFrame);
+    }
+
+    void bufferReleased(Buffer& buffer)
+    {
+        buffer.busy = false;
+        m_observer.bufferReleased(buffer.frame);
+
+        if (m_framePending)
+            renderFrame();
+    }
+
+    static const struct wl_buffer_listener s_bufferListener;
+
+    Observer& m_observer;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_stride { 0 };
+    size_t m_size { 0 };
+    uint8_t* m_data { nullptr };
+
+    std::array<Buffer, 3> m_buffers;
+
+    uint64_t m_frameCount { 0 };
+    uint64_t m_currentFrame { 0 };
+    bool m_framePending { false };
+};
+
+const struct wl_buffer_listener ShmClient::Private::s_bufferListener = {
+    // release
+    [](void* data, struct wl_buffer*)
+    {
+        auto& buffer = *static_cast<Buffer*>(data);
+        buffer.target->bufferReleased(buffer);
+    },
+};
+
+ShmClient::ShmClient(int backendFD, int targetFD, uint32_t width, uint32_t height, Observer& observer)
+    : m_backend(new Backend(backendFD))
+    , m_private(new Private(*m_backend, targetFD, width, height, observer))
+{
+}
+
+ShmClient::~ShmClient() = default;
+
+void ShmClient::renderFrame()
+{
+    m_private->renderFrame();
+}
+
+uint64_t ShmClient::framesCommitted() const
+{
+    return m_private->framesCommitted();
+}
+
+} // namespace Bench
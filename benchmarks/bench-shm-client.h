@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace Bench {
+
+// Client side of the benchmarks: a nested compositor client built on top of
+// WS::BaseBackend and WS::BaseTarget which renders into wl_shm buffers, the
+// same way a WebProcess connected to a wpe_fdo_initialize_shm() host would
+// do minus the actual painting. Must be used from a thread other than the
+// one running the host, as the setup may wait for the registry of the backend.
+class ShmClient {
+public:
+    class Observer {
+    public:
+        virtual ~Observer() = default;
+
+        virtual void frameCommitted(uint64_t frame) = 0;
+        virtual void bufferReleased(uint64_t frame) = 0;
+        virtual void frameDone(uint64_t frame) = 0;
+    };
+
+    // backendFD comes from the renderer host (WS::Instance::createClient()),
+    // targetFD from the view backend (wpe_view_backend_get_renderer_host_fd()).
+    ShmClient(int backendFD, int targetFD, uint32_t width, uint32_t height, Observer&);
+    ~ShmClient();
+
+    // Fills the next free buffer and commits it along with a frame callback.
+    // If all buffers are held by the host, the frame is committed as soon as
+    // one of them is released.
+    void renderFrame();
+
+    uint64_t framesCommitted() const;
+
+private:
+    class Backend;
+    class Private;
+
+    // Declared first, as the target must be torn down before the connection.
+    std::unique_ptr<Backend> m_backend;
+    std::unique_ptr<Private> m_private;
+};
+
+} // namespace Bench
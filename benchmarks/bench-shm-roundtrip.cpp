@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Measures the SHM frame loop of the nested compositor, entirely in-process
+// and without any GPU involvement: the client commits a wl_shm buffer, the
+// host exports it through export_shm_buffer, the embedder (this program)
+// releases it right away with dispatch_release_shm_exported_buffer and
+// completes the frame, and the client renders the next frame as soon as
+// the frame callback arrives.
+
+#include "bench-shm-client.h"
+#include "bench-utils.h"
+
+#include "../src/ws.h"
+#include <wpe/fdo.h>
+#include <wpe/unstable/fdo-shm.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <memory>
+
+namespace {
+
+struct FrameRecord {
+    std::atomic<int64_t> committed { 0 };
+    std::atomic<int64_t> exported { 0 };
+    std::atomic<int64_t> released { 0 };
+    std::atomic<int64_t> done { 0 };
+};
+
+struct Options {
+    gint frames { 5000 };
+    gint warmup { 100 };
+    gint width { 1280 };
+    gint height { 720 };
+};
+
+class Benchmark final : public Bench::ShmClient::Observer {
+public:
+    explicit Benchmark(const Options& options)
+        : m_options(options)
+        , m_totalFrames(options.warmup + options.frames)
+        , m_records(new FrameRecord[m_totalFrames])
+    {
+        m_host.context = g_main_context_default();
+        m_host.loop = g_main_loop_new(m_host.context, FALSE);
+    }
+
+    ~Benchmark()
+    {
+        g_main_loop_unref(m_host.loop);
+    }
+
+    bool run()
+    {
+        if (!wpe_fdo_initialize_shm()) {
+            std::fprintf(stderr, "Failed to initialize the SHM nested compositor\n");
+            return false;
+        }
+
+        static const struct wpe_view_backend_exportable_fdo_client s_exportableClient = {
+            nullptr, // export_buffer_resource
+            nullptr, // export_dmabuf_resource
+            // export_shm_buffer
+            [](void* data, struct wpe_fdo_shm_exported_buffer* buffer)
+            {
+                static_cast<Benchmark*>(data)->exportShmBuffer(buffer);
+            },
+            nullptr,
+            nullptr,
+        };
+
+        m_host.exportable = wpe_view_backend_exportable_fdo_create(&s_exportableClient, this, m_options.width, m_options.height);
+        struct wpe_view_backend* viewBackend = wpe_view_backend_exportable_fdo_get_view_backend(m_host.exportable);
+        wpe_view_backend_initialize(viewBackend);
+
+        m_client.backendFD = WS::Instance::singleton().createClient();
+        m_client.targetFD = wpe_view_backend_get_renderer_host_fd(viewBackend);
+        if (m_client.backendFD == -1 || m_client.targetFD == -1) {
+            std::fprintf(stderr, "Failed to create the client connections\n");
+            return false;
+        }
+
+        m_client.thread = g_thread_new("bench-client", s_clientThread, this);
+        g_main_loop_run(m_host.loop);
+        g_thread_join(m_client.thread);
+
+        wpe_view_backend_exportable_fdo_destroy(m_host.exportable);
+
+        report();
+        return true;
+    }
+
+private:
+    static int64_t now() { return g_get_monotonic_time(); }
+
+    FrameRecord* record(uint64_t frame)
+    {
+        if (frame >= uint64_t(m_totalFrames))
+            return nullptr;
+        return &m_records[frame];
+    }
+
+    // Host side, runs on the main thread.
+    void exportShmBuffer(struct wpe_fdo_shm_exported_buffer* buffer)
+    {
+        if (auto* r = record(m_host.framesExported++))
+            r->exported.store(now(), std::memory_order_relaxed);
+
+        wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(m_host.exportable, buffer);
+        wpe_view_backend_exportable_fdo_dispatch_frame_complete(m_host.exportable);
+    }
+
+    // Bench::ShmClient::Observer, runs on the client thread.
+    void frameCommitted(uint64_t frame) override
+    {
+        if (frame == uint64_t(m_options.warmup))
+            m_client.startTime = now();
+        if (auto* r = record(frame))
+            r->committed.store(now(), std::memory_order_relaxed);
+    }
+
+    void bufferReleased(uint64_t frame) override
+    {
+        if (auto* r = record(frame))
+            r->released.store(now(), std::memory_order_relaxed);
+    }
+
+    void frameDone(uint64_t frame) override
+    {
+        if (auto* r = record(frame))
+            r->done.store(now(), std::memory_order_relaxed);
+
+        if (frame + 1 >= uint64_t(m_totalFrames)) {
+            m_client.endTime = now();
+            g_main_loop_quit(m_client.loop);
+            return;
+        }
+
+        m_client.client->renderFrame();
+    }
+
+    static gpointer s_clientThread(gpointer data)
+    {
+        auto& benchmark = *static_cast<Benchmark*>(data);
+        auto& client = benchmark.m_client;
+
+        GMainContext* context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        client.loop = g_main_loop_new(context, FALSE);
+
+        client.client.reset(new Bench::ShmClient(client.backendFD, client.targetFD,
+            benchmark.m_options.width, benchmark.m_options.height, benchmark));
+
+        // The surface is registered with the view backend through a separate
+        // socket; let the host process that before committing the first frame,
+        // otherwise the commit would be held until then and skew the first
+        // measurements.
+        g_main_context_invoke(benchmark.m_host.context,
+            [](gpointer data) -> gboolean {
+                auto& benchmark = *static_cast<Benchmark*>(data);
+                while (g_main_context_iteration(benchmark.m_host.context, FALSE)) { }
+
+                g_main_context_invoke(g_main_loop_get_context(benchmark.m_client.loop),
+                    [](gpointer data) -> gboolean {
+                        static_cast<Benchmark*>(data)->m_client.client->renderFrame();
+                        return G_SOURCE_REMOVE;
+                    }, data);
+                return G_SOURCE_REMOVE;
+            }, &benchmark);
+
+        g_main_loop_run(client.loop);
+
+        client.client = nullptr;
+        g_main_loop_unref(client.loop);
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+
+        g_main_context_invoke(benchmark.m_host.context,
+            [](gpointer data) -> gboolean {
+                g_main_loop_quit(static_cast<Benchmark*>(data)->m_host.loop);
+                return G_SOURCE_REMOVE;
+            }, &benchmark);
+        return nullptr;
+    }
+
+    void report()
+    {
+        Bench::Samples commitToExport, exportToRelease, exportToFrameDone, commitToFrameDone;
+        for (auto* s : { &commitToExport, &exportToRelease, &exportToFrameDone, &commitToFrameDone })
+            s->reserve(m_options.frames);
+
+        for (gint i = m_options.warmup; i < m_totalFrames; ++i) {
+            auto& r = m_records[i];
+            int64_t committed = r.committed.load();
+            int64_t exported = r.exported.load();
+            int64_t released = r.released.load();
+            int64_t done = r.done.load();
+
+            if (committed && exported)
+                commitToExport.add(exported - committed);
+            if (exported && released)
+                exportToRelease.add(released - exported);
+            if (exported && done)
+                exportToFrameDone.add(done - exported);
+            if (committed && done)
+                commitToFrameDone.add(done - committed);
+        }
+
+        double seconds = (m_client.endTime - m_client.startTime) / 1000000.0;
+        std::printf("bench-shm-roundtrip: %d frames of %dx%d\n", m_options.frames, m_options.width, m_options.height);
+        std::printf("  %-24s %.1f\n", "frames/s", seconds > 0 ? m_options.frames / seconds : 0);
+        commitToExport.print("commit -> export");
+        exportToRelease.print("export -> release");
+        exportToFrameDone.print("export -> frame done");
+        commitToFrameDone.print("commit -> frame done");
+    }
+
+    Options m_options;
+    gint m_totalFrames;
+    std::unique_ptr<FrameRecord[]> m_records;
+
+    struct {
+        GMainContext* context { nullptr };
+        GMainLoop* loop { nullptr };
+        struct wpe_view_backend_exportable_fdo* exportable { nullptr };
+        uint64_t framesExported { 0 };
+    } m_host;
+
+    struct {
+        int backendFD { -1 };
+        int targetFD { -1 };
+        GThread* thread { nullptr };
+        GMainLoop* loop { nullptr };
+        std::unique_ptr<Bench::ShmClient> client;
+        int64_t startTime { 0 };
+        int64_t endTime { 0 };
+    } m_client;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry entries[] = {
+        { "frames", 'n', 0, G_OPTION_ARG_INT, &options.frames, "Number of measured frames", "N" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup, "Number of frames rendered before measuring", "N" },
+        { "width", 0, 0, G_OPTION_ARG_INT, &options.width, "Buffer width", "PIXELS" },
+        { "height", 0, 0, G_OPTION_ARG_INT, &options.height, "Buffer height", "PIXELS" },
+        { nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr },
+    };
+
+    GError* error = nullptr;
+    GOptionContext* context = g_option_context_new("- measure the SHM buffer round-trip");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (options.frames <= 0 || options.warmup < 0 || options.width <= 0 || options.height <= 0) {
+        std::fprintf(stderr, "Invalid options\n");
+        return EXIT_FAILURE;
+    }
+
+    Benchmark benchmark(options);
+    return benchmark.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Bench {
+
+// Collects latency samples (in microseconds) and reports their distribution.
+class Samples {
+public:
+    void reserve(size_t size) { m_values.reserve(size); }
+    void add(int64_t value) { m_values.push_back(value); m_sorted = false; }
+    void add(const Samples& other)
+    {
+        m_values.insert(m_values.end(), other.m_values.begin(), other.m_values.end());
+        m_sorted = false;
+    }
+    size_t size() const { return m_values.size(); }
+
+    int64_t percentile(double p)
+    {
+        if (m_values.empty())
+            return 0;
+
+        if (!m_sorted) {
+            std::sort(m_values.begin(), m_values.end());
+            m_sorted = true;
+        }
+
+        size_t index = static_cast<size_t>(p / 100 * (m_values.size() - 1) + 0.5);
+        return m_values[std::min(index, m_values.size() - 1)];
+    }
+
+    void print(const char* name)
+    {
+        std::printf("  %-24s p50 %8.3f ms   p99 %8.3f ms   max %8.3f ms   (%zu samples)\n", name,
+            percentile(50) / 1000.0, percentile(99) / 1000.0, percentile(100) / 1000.0, size());
+    }
+
+private:
+    std::vector<int64_t> m_values;
+    bool m_sorted { true };
+};
+
+} // namespace Bench
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Load generator for the nested compositor: spawns N client processes, each
+// one standing in for a WebProcess rendering into wl_shm buffers at a given
+// size and frame rate, against a host creating N exportable view backends.
+// The host behaves like a simple embedder: it keeps the last exported buffer
+// of each view until the next one arrives and completes frames immediately.
+//
+// Reported: aggregate throughput, frame time distribution across views, and
+// the CPU time and memory used by the host (UI) process.
+
+#include "bench-shm-client.h"
+#include "bench-utils.h"
+
+#include "../src/ws.h"
+#include <wpe/fdo.h>
+#include <wpe/unstable/fdo-shm.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Options {
+    gint views { 16 };
+    gint width { 1280 };
+    gint height { 720 };
+    gint fps { 60 };
+    gint duration { 10 };
+    gint warmup { 2 };
+    gboolean verbose { FALSE };
+
+    // Used by the spawned client processes.
+    gboolean child { FALSE };
+    gint backendFD { -1 };
+    gint targetFD { -1 };
+};
+
+class Client final : public Bench::ShmClient::Observer {
+public:
+    explicit Client(const Options& options)
+        : m_options(options)
+    {
+    }
+
+    int run()
+    {
+        GMainContext* context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        m_loop = g_main_loop_new(context, FALSE);
+
+        m_client.reset(new Bench::ShmClient(m_options.backendFD, m_options.targetFD,
+            m_options.width, m_options.height, *this));
+
+        // Rendering starts right away: a commit which reaches the host before
+        // the surface is registered with the view backend is deferred until
+        // then, and the warm-up period covers the bring-up of all views.
+        if (m_options.fps > 0) {
+            GSource* source = g_timeout_source_new(std::max(1000 / m_options.fps, 1));
+            g_source_set_callback(source,
+                [](gpointer data) -> gboolean {
+                    auto& client = *static_cast<Client*>(data);
+                    if (!client.m_frameInFlight)
+                        client.renderFrame();
+                    return G_SOURCE_CONTINUE;
+                }, this, nullptr);
+            g_source_attach(source, context);
+            g_source_unref(source);
+        } else
+            renderFrame();
+
+        // Runs until the host terminates the process.
+        g_main_loop_run(m_loop);
+        return EXIT_SUCCESS;
+    }
+
+private:
+    void renderFrame()
+    {
+        m_frameInFlight = true;
+        m_client->renderFrame();
+    }
+
+    // Bench::ShmClient::Observer
+    void frameCommitted(uint64_t) override { }
+    void bufferReleased(uint64_t) override { }
+    void frameDone(uint64_t) override
+    {
+        m_frameInFlight = false;
+        if (m_options.fps <= 0)
+            renderFrame();
+    }
+
+    const Options& m_options;
+    GMainLoop* m_loop { nullptr };
+    std::unique_ptr<Bench::ShmClient> m_client;
+    bool m_frameInFlight { false };
+};
+
+class Host {
+public:
+    explicit Host(const Options& options)
+        : m_options(options)
+    {
+        m_loop = g_main_loop_new(nullptr, FALSE);
+    }
+
+    ~Host()
+    {
+        for (auto& view : m_views) {
+            if (view->current)
+                wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(view->exportable, view->current);
+            wpe_view_backend_exportable_fdo_destroy(view->exportable);
+        }
+        g_main_loop_unref(m_loop);
+    }
+
+    int run(const char* program)
+    {
+        if (!wpe_fdo_initialize_shm()) {
+            std::fprintf(stderr, "Failed to initialize the SHM nested compositor\n");
+            return EXIT_FAILURE;
+        }
+
+        for (gint i = 0; i < m_options.views; ++i) {
+            if (!spawnView(program, i)) {
+                terminateClients();
+                return EXIT_FAILURE;
+            }
+        }
+
+        g_timeout_add_seconds(m_options.warmup,
+            [](gpointer data) -> gboolean {
+                static_cast<Host*>(data)->startMeasuring();
+                return G_SOURCE_REMOVE;
+            }, this);
+        g_timeout_add_seconds(m_options.warmup + m_options.duration,
+            [](gpointer data) -> gboolean {
+                auto& host = *static_cast<Host*>(data);
+                host.stopMeasuring();
+                g_main_loop_quit(host.m_loop);
+                return G_SOURCE_REMOVE;
+            }, this);
+
+        g_main_loop_run(m_loop);
+
+        terminateClients();
+        report();
+        return EXIT_SUCCESS;
+    }
+
+private:
+    struct View {
+        Host* host { nullptr };
+        struct wpe_view_backend_exportable_fdo* exportable { nullptr };
+        struct wpe_fdo_shm_exported_buffer* current { nullptr };
+        pid_t pid { -1 };
+
+        int64_t lastExport { 0 };
+        uint64_t frames { 0 };
+        Bench::Samples frameTimes;
+    };
+
+    static int64_t now() { return g_get_monotonic_time(); }
+
+    static int64_t cpuTime()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC
+            + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+
+    static void memoryUsage(long& rssKiB, long& peakKiB)
+    {
+        rssKiB = peakKiB = 0;
+        FILE* file = std::fopen("/proc/self/status", "r");
+        if (!file)
+            return;
+
+        char line[256];
+        while (std::fgets(line, sizeof(line), file)) {
+            if (!std::strncmp(line, "VmRSS:", 6))
+                rssKiB = std::strtol(line + 6, nullptr, 10);
+            else if (!std::strncmp(line, "VmHWM:", 6))
+                peakKiB = std::strtol(line + 6, nullptr, 10);
+        }
+        std::fclose(file);
+    }
+
+    bool spawnView(const char* program, gint index)
+    {
+        static const struct wpe_view_backend_exportable_fdo_client s_exportableClient = {
+            nullptr, // export_buffer_resource
+            nullptr, // export_dmabuf_resource
+            // export_shm_buffer
+            [](void* data, struct wpe_fdo_shm_exported_buffer* buffer)
+            {
+                auto& view = *static_cast<View*>(data);
+                view.host->exportShmBuffer(view, buffer);
+            },
+            nullptr,
+            nullptr,
+        };
+
+        std::unique_ptr<View> view(new View);
+        view->host = this;
+        view->exportable = wpe_view_backend_exportable_fdo_create(&s_exportableClient, view.get(), m_options.width, m_options.height);
+
+        struct wpe_view_backend* viewBackend = wpe_view_backend_exportable_fdo_get_view_backend(view->exportable);
+        wpe_view_backend_initialize(viewBackend);
+
+        int backendFD = WS::Instance::singleton().createClient();
+        int targetFD = wpe_view_backend_get_renderer_host_fd(viewBackend);
+        if (backendFD == -1 || targetFD == -1) {
+            std::fprintf(stderr, "Failed to create the client connections for view %d\n", index);
+            wpe_view_backend_exportable_fdo_destroy(view->exportable);
+            return false;
+        }
+
+        std::fflush(stdout);
+        std::fflush(stderr);
+
+        view->pid = fork();
+        if (view->pid == -1) {
+            std::fprintf(stderr, "Failed to spawn client %d: %s\n", index, std::strerror(errno));
+            wpe_view_backend_exportable_fdo_destroy(view->exportable);
+            return false;
+        }
+
+        if (!view->pid) {
+            char* argv[] = {
+                const_cast<char*>(program),
+                const_cast<char*>("--child"),
+                g_strdup_printf("--backend-fd=%d", backendFD),
+                g_strdup_printf("--target-fd=%d", targetFD),
+                g_strdup_printf("--width=%d", m_options.width),
+                g_strdup_printf("--height=%d", m_options.height),
+                g_strdup_printf("--fps=%d", m_options.fps),
+                nullptr,
+            };
+            execv("/proc/self/exe", argv);
+            _exit(EXIT_FAILURE);
+        }
+
+        close(backendFD);
+        close(targetFD);
+
+        m_views.push_back(std::move(view));
+        return true;
+    }
+
+    void terminateClients()
+    {
+        for (auto& view : m_views) {
+            if (view->pid > 0)
+                kill(view->pid, SIGTERM);
+        }
+        for (auto& view : m_views) {
+            if (view->pid > 0)
+                waitpid(view->pid, nullptr, 0);
+            view->pid = -1;
+        }
+    }
+
+    void exportShmBuffer(View& view, struct wpe_fdo_shm_exported_buffer* buffer)
+    {
+        if (view.current)
+            wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(view.exportable, view.current);
+        view.current = buffer;
+
+        if (m_measuring) {
+            int64_t time = now();
+            if (view.lastExport)
+                view.frameTimes.add(time - view.lastExport);
+            view.lastExport = time;
+            view.frames++;
+        }
+
+        wpe_view_backend_exportable_fdo_dispatch_frame_complete(view.exportable);
+    }
+
+    void startMeasuring()
+    {
+        m_measuring = true;
+        m_start.time = now();
+        m_start.cpuTime = cpuTime();
+    }
+
+    void stopMeasuring()
+    {
+        m_measuring = false;
+        m_end.time = now();
+        m_end.cpuTime = cpuTime();
+    }
+
+    void report()
+    {
+        double seconds = (m_end.time - m_start.time) / double(G_USEC_PER_SEC);
+        double cpuSeconds = (m_end.cpuTime - m_start.cpuTime) / double(G_USEC_PER_SEC);
+
+        uint64_t totalFrames = 0;
+        Bench::Samples frameTimes, viewP99, viewFps;
+        for (auto& view : m_views) {
+            totalFrames += view->frames;
+            viewP99.add(view->frameTimes.percentile(99));
+            viewFps.add(seconds > 0 ? int64_t(view->frames / seconds) : 0);
+        }
+        frameTimes.reserve(totalFrames);
+        for (auto& view : m_views)
+            frameTimes.add(view->frameTimes);
+
+        long rss, peakRss;
+        memoryUsage(rss, peakRss);
+
+        std::printf("bench-view-scaling: %d views of %dx%d at %s%d fps, %.1f s\n", m_options.views,
+            m_options.width, m_options.height, m_options.fps > 0 ? "" : "unthrottled, ", std::max(m_options.fps, 0), seconds);
+        std::printf("  %-24s %.1f frames/s (%.1f per view)\n", "throughput",
+            seconds > 0 ? totalFrames / seconds : 0, seconds > 0 && !m_views.empty() ? totalFrames / seconds / m_views.size() : 0);
+        std::printf("  %-24s %.2f s (%.1f%% of one core)\n", "UI process CPU time", cpuSeconds,
+            seconds > 0 ? 100 * cpuSeconds / seconds : 0);
+        std::printf("  %-24s %ld KiB (peak %ld KiB)\n", "UI process RSS", rss, peakRss);
+        std::printf("  %-24s min %" G_GINT64_FORMAT "   p50 %" G_GINT64_FORMAT "   max %" G_GINT64_FORMAT "\n",
+            "frames/s per view", viewFps.percentile(0), viewFps.percentile(50), viewFps.percentile(100));
+        frameTimes.print("frame time (all views)");
+        viewP99.print("per-view p99 frame time");
+
+        if (m_options.verbose) {
+            for (size_t i = 0; i < m_views.size(); ++i) {
+                char name[32];
+                std::snprintf(name, sizeof(name), "view %zu frame time", i);
+                m_views[i]->frameTimes.print(name);
+            }
+        }
+    }
+
+    const Options& m_options;
+    GMainLoop* m_loop { nullptr };
+    std::vector<std::unique_ptr<View>> m_views;
+
+    bool m_measuring { false };
+    struct {
+        int64_t time { 0 };
+        int64_t cpuTime { 0 };
+    } m_start, m_end;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry entries[] = {
+        { "views", 'n', 0, G_OPTION_ARG_INT, &options.views, "Number of views and client processes", "N" },
+        { "width", 0, 0, G_OPTION_ARG_INT, &options.width, "Buffer width", "PIXELS" },
+        { "height", 0, 0, G_OPTION_ARG_INT, &options.height, "Buffer height", "PIXELS" },
+        { "fps", 'r', 0, G_OPTION_ARG_INT, &options.fps, "Frame rate of each client, 0 for unthrottled", "FPS" },
+        { "duration", 'd', 0, G_OPTION_ARG_INT, &options.duration, "Measurement duration", "SECONDS" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup, "Time to run before measuring", "SECONDS" },
+        { "verbose", 'v', 0, G_OPTION_ARG_NONE, &options.verbose, "Print the frame time distribution of each view", nullptr },
+        { "child", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &options.child, nullptr, nullptr },
+        { "backend-fd", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &options.backendFD, nullptr, nullptr },
+        { "target-fd", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &options.targetFD, nullptr, nullptr },
+        { nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr },
+    };
+
+    GError* error = nullptr;
+    GOptionContext* context = g_option_context_new("- load the nested compositor with many views");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (options.child) {
+        if (options.backendFD == -1 || options.targetFD == -1)
+            return EXIT_FAILURE;
+        return Client(options).run();
+    }
+
+    if (options.views <= 0 || options.width <= 0 || options.height <= 0 || options.duration <= 0 || options.warmup < 0) {
+        std::fprintf(stderr, "Invalid options\n");
+        return EXIT_FAILURE;
+    }
+
+    Host host(options);
+    return host.run(argv[0]);
+}
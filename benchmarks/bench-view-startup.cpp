@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Measures how long it takes for a new view to be able to render, and to get
+// its first frame presented: for each iteration the host creates an
+// exportable view backend, and a fresh client connection creates its backend
+// and target, renders one frame as soon as the target is created, and waits
+// for its frame callback. The host releases buffers and completes frames
+// right away, as in bench-shm-roundtrip.
+//
+// "create -> will render" stands for the time a WebProcess spends
+// creating its renderer backend and target before it can start painting,
+// which is where initialization roundtrips show up.
+
+#include "bench-shm-client.h"
+#include "bench-utils.h"
+
+#include "../src/ws.h"
+#include <wpe/fdo.h>
+#include <wpe/unstable/fdo-shm.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <memory>
+
+namespace {
+
+struct Options {
+    gint iterations { 200 };
+    gint warmup { 10 };
+    gint width { 1280 };
+    gint height { 720 };
+};
+
+class Benchmark final : public Bench::ShmClient::Observer {
+public:
+    explicit Benchmark(const Options& options)
+        : m_options(options)
+    {
+        m_host.context = g_main_context_default();
+        m_host.loop = g_main_loop_new(m_host.context, FALSE);
+
+        for (auto* s : { &m_createToTarget, &m_createToWillRender, &m_createToFrameDone })
+            s->reserve(m_options.iterations);
+    }
+
+    ~Benchmark()
+    {
+        g_main_loop_unref(m_host.loop);
+    }
+
+    bool run()
+    {
+        if (!wpe_fdo_initialize_shm()) {
+            std::fprintf(stderr, "Failed to initialize the SHM nested compositor\n");
+            return false;
+        }
+
+        g_idle_add([](gpointer data) -> gboolean {
+            static_cast<Benchmark*>(data)->startIteration();
+            return G_SOURCE_REMOVE;
+        }, this);
+        g_main_loop_run(m_host.loop);
+
+        report();
+        return !m_failed;
+    }
+
+private:
+    static int64_t now() { return g_get_monotonic_time(); }
+
+    // Host side, runs on the main thread.
+    void startIteration()
+    {
+        static const struct wpe_view_backend_exportable_fdo_client s_exportableClient = {
+            nullptr, // export_buffer_resource
+            nullptr, // export_dmabuf_resource
+            // export_shm_buffer
+            [](void* data, struct wpe_fdo_shm_exported_buffer* buffer)
+            {
+                auto& benchmark = *static_cast<Benchmark*>(data);
+                wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(benchmark.m_host.exportable, buffer);
+                wpe_view_backend_exportable_fdo_dispatch_frame_complete(benchmark.m_host.exportable);
+            },
+            nullptr,
+            nullptr,
+        };
+
+        m_host.exportable = wpe_view_backend_exportable_fdo_create(&s_exportableClient, this, m_options.width, m_options.height);
+        struct wpe_view_backend* viewBackend = wpe_view_backend_exportable_fdo_get_view_backend(m_host.exportable);
+        wpe_view_backend_initialize(viewBackend);
+
+        m_client.backendFD = WS::Instance::singleton().createClient();
+        m_client.targetFD = wpe_view_backend_get_renderer_host_fd(viewBackend);
+        if (m_client.backendFD == -1 || m_client.targetFD == -1) {
+            std::fprintf(stderr, "Failed to create the client connections\n");
+            m_failed = true;
+            g_main_loop_quit(m_host.loop);
+            return;
+        }
+
+        m_client.thread = g_thread_new("bench-client", s_clientThread, this);
+    }
+
+    void finishIteration()
+    {
+        g_thread_join(m_client.thread);
+        m_client.thread = nullptr;
+
+        g_clear_pointer(&m_host.exportable, wpe_view_backend_exportable_fdo_destroy);
+
+        if (m_iteration >= m_options.warmup) {
+            m_createToTarget.add(m_client.targetCreated - m_client.startTime);
+            m_createToWillRender.add(m_client.willRender - m_client.startTime);
+            m_createToFrameDone.add(m_client.frameDone - m_client.startTime);
+        }
+
+        if (++m_iteration >= m_options.warmup + m_options.iterations) {
+            g_main_loop_quit(m_host.loop);
+            return;
+        }
+        startIteration();
+    }
+
+    // Bench::ShmClient::Observer, runs on the client thread.
+    void frameCommitted(uint64_t frame) override
+    {
+        if (!frame)
+            m_client.willRender = now();
+    }
+
+    void bufferReleased(uint64_t) override { }
+
+    void frameDone(uint64_t frame) override
+    {
+        if (frame)
+            return;
+
+        m_client.frameDone = now();
+        g_main_loop_quit(m_client.loop);
+    }
+
+    static gpointer s_clientThread(gpointer data)
+    {
+        auto& benchmark = *static_cast<Benchmark*>(data);
+        auto& client = benchmark.m_client;
+
+        GMainContext* context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        client.loop = g_main_loop_new(context, FALSE);
+
+        client.startTime = now();
+        std::unique_ptr<Bench::ShmClient> shmClient(new Bench::ShmClient(client.backendFD, client.targetFD,
+            benchmark.m_options.width, benchmark.m_options.height, benchmark));
+        client.targetCreated = now();
+        shmClient->renderFrame();
+
+        g_main_loop_run(client.loop);
+
+        shmClient = nullptr;
+        g_main_loop_unref(client.loop);
+        client.loop = nullptr;
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+
+        g_main_context_invoke(benchmark.m_host.context,
+            [](gpointer data) -> gboolean {
+                static_cast<Benchmark*>(data)->finishIteration();
+                return G_SOURCE_REMOVE;
+            }, &benchmark);
+        return nullptr;
+    }
+
+    void report()
+    {
+        std::printf("bench-view-startup: %d views of %dx%d\n", m_options.iterations, m_options.width, m_options.height);
+        m_createToTarget.print("create -> target");
+        m_createToWillRender.print("create -> will render");
+        m_createToFrameDone.print("create -> frame done");
+    }
+
+    Options m_options;
+    gint m_iteration { 0 };
+    bool m_failed { false };
+
+    Bench::Samples m_createToTarget;
+    Bench::Samples m_createToWillRender;
+    Bench::Samples m_createToFrameDone;
+
+    struct {
+        GMainContext* context { nullptr };
+        GMainLoop* loop { nullptr };
+        struct wpe_view_backend_exportable_fdo* exportable { nullptr };
+    } m_host;
+
+    struct {
+        int backendFD { -1 };
+        int targetFD { -1 };
+        GThread* thread { nullptr };
+        GMainLoop* loop { nullptr };
+        int64_t startTime { 0 };
+        int64_t targetCreated { 0 };
+        int64_t willRender { 0 };
+        int64_t frameDone { 0 };
+    } m_client;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    GOptionEntry entries[] = {
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &options.iterations, "Number of measured views", "N" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &options.warmup, "Number of views created before measuring", "N" },
+        { "width", 0, 0, G_OPTION_ARG_INT, &options.width, "Buffer width", "PIXELS" },
+        { "height", 0, 0, G_OPTION_ARG_INT, &options.height, "Buffer height", "PIXELS" },
+        { nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr },
+    };
+
+    GError* error = nullptr;
+    GOptionContext* context = g_option_context_new("- measure the time it takes for new views to render");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        std::fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    if (options.iterations <= 0 || options.warmup < 0 || options.width <= 0 || options.height <= 0) {
+        std::fprintf(stderr, "Invalid options\n");
+        return EXIT_FAILURE;
+    }
+
+    Benchmark benchmark(options);
+    return benchmark.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
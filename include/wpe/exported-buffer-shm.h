@@ -30,20 +30,60 @@
 #ifndef __exported_buffer_shm_h__
 #define __exported_buffer_shm_h__
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct wpe_fdo_rectangle;
 struct wpe_fdo_shm_exported_buffer;
+struct wpe_fdo_viewport;
 struct wl_resource;
 struct wl_shm_buffer;
 
+/* Linear dma-buf wrapping the memory of a shm buffer. format is a DRM fourcc
+ * code, and the file descriptor is owned by the exported buffer. */
+struct wpe_fdo_shm_dmabuf_attributes {
+    int fd;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t offset;
+    uint32_t stride;
+    uint64_t modifier;
+};
+
 struct wl_resource*
 wpe_fdo_shm_exported_buffer_get_resource(struct wpe_fdo_shm_exported_buffer*);
 
 struct wl_shm_buffer*
 wpe_fdo_shm_exported_buffer_get_shm_buffer(struct wpe_fdo_shm_exported_buffer*);
 
+/* Transform, scale and cropping requested by the client for the buffer. */
+void
+wpe_fdo_shm_exported_buffer_get_viewport(struct wpe_fdo_shm_exported_buffer*, struct wpe_fdo_viewport*);
+
+/* Opaque region of the buffer, owned by the buffer. n_rects is 0 when the
+ * client did not declare any part of the buffer as opaque. */
+const struct wpe_fdo_rectangle*
+wpe_fdo_shm_exported_buffer_get_opaque_region(struct wpe_fdo_shm_exported_buffer*, uint32_t* n_rects);
+
+/* Only available when initialized with wpe_fdo_initialize_shm_with_udmabuf(),
+ * for clients which allocate their pools from memfds sealed against shrinking.
+ * Returns false otherwise, in which case the shm buffer has to be used. */
+bool
+wpe_fdo_shm_exported_buffer_get_dmabuf_attributes(struct wpe_fdo_shm_exported_buffer*, struct wpe_fdo_shm_dmabuf_attributes*);
+
+/* Read-only contents of the buffer, mapped until the buffer is released. If
+ * the client memory is sealed against shrinking, the contents can be read from
+ * any thread without further care and guarded is set to false. Otherwise it is
+ * set to true, and accesses must be bracketed with wl_shm_buffer_begin_access()
+ * and wl_shm_buffer_end_access() on the shm buffer. */
+const void*
+wpe_fdo_shm_exported_buffer_get_data(struct wpe_fdo_shm_exported_buffer*, bool* guarded);
+
 #ifdef __cplusplus
 }
 #endif
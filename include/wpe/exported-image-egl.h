@@ -51,6 +51,8 @@ extern "C" {
 typedef void* EGLImageKHR;
 
 struct wpe_fdo_egl_exported_image;
+struct wpe_fdo_rectangle;
+struct wpe_fdo_viewport;
 
 /**
  * wpe_fdo_egl_exported_image_get_width:
@@ -85,6 +87,53 @@ wpe_fdo_egl_exported_image_get_height(struct wpe_fdo_egl_exported_image *image);
 EGLImageKHR
 wpe_fdo_egl_exported_image_get_egl_image(struct wpe_fdo_egl_exported_image *image);
 
+/**
+ * wpe_fdo_egl_exported_image_get_acquire_fence:
+ * @image: (transfer none): An exported EGL image.
+ *
+ * Gets the fence which signals once the client has finished rendering into
+ * the exported @image. The fence should be waited on, for example importing
+ * it with `EGL_ANDROID_native_fence_sync`, before sampling from the image.
+ *
+ * The file descriptor remains owned by the @image and stays valid until the
+ * image is released; use `dup()` to keep it for longer.
+ *
+ * Returns: A sync_file descriptor, or `-1` if the client did not provide one.
+ */
+int
+wpe_fdo_egl_exported_image_get_acquire_fence(struct wpe_fdo_egl_exported_image *image);
+
+/**
+ * wpe_fdo_egl_exported_image_get_viewport:
+ * @image: (transfer none): An exported EGL image.
+ * @viewport: (out): Location where to store the viewport.
+ *
+ * Gets how the client requested the exported @image to be presented: its
+ * buffer transform and scale, and the cropping and scaling set through
+ * wp_viewporter. The client may render at a lower resolution than the size
+ * of the view, in which case the destination size is the size at which the
+ * image is to be presented.
+ */
+void
+wpe_fdo_egl_exported_image_get_viewport(struct wpe_fdo_egl_exported_image *image, struct wpe_fdo_viewport *viewport);
+
+/**
+ * wpe_fdo_egl_exported_image_get_opaque_region:
+ * @image: (transfer none): An exported EGL image.
+ * @n_rects: (out): Location where to store the number of rectangles.
+ *
+ * Gets the region of the exported @image which the client declared as
+ * opaque. Blending may be disabled for this area, and contents underneath
+ * it need not be drawn. When the region covers the whole view, the image
+ * can be presented as fully opaque.
+ *
+ * Returns: (transfer none) (array length=n_rects): The rectangles of the
+ *   opaque region, valid until the image is released, or %NULL if the image
+ *   has no opaque region.
+ */
+const struct wpe_fdo_rectangle*
+wpe_fdo_egl_exported_image_get_opaque_region(struct wpe_fdo_egl_exported_image *image, uint32_t *n_rects);
+
 #ifdef __cplusplus
 }
 #endif
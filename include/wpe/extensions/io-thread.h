@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __io_thread_h__
+#define __io_thread_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * SECTION:io-thread
+ * @title: Extensions I/O thread
+ * @short_description: Thread servicing the client-side extensions
+ *
+ * The audio and video plane sources receive the release notifications for
+ * the resources they send to the UI process on a single thread, started
+ * when the first source is created. These functions allow configuring it so
+ * that it can be placed next to the media pipeline threads: the name is used
+ * when the thread starts, while the affinity and priority also apply to an
+ * already running thread.
+ */
+
+void
+wpe_extensions_io_thread_set_name(const char* name);
+
+/* Restricts the thread to the given CPUs; passing none lifts the restriction. */
+void
+wpe_extensions_io_thread_set_affinity(const unsigned* cpus, unsigned n_cpus);
+
+/* Sets the nice value of the thread. */
+void
+wpe_extensions_io_thread_set_priority(int nice);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __io_thread_h__
@@ -90,6 +90,39 @@ wpe_video_plane_display_dmabuf_register_receiver(const struct wpe_video_plane_di
 void
 wpe_video_plane_display_dmabuf_export_release(struct wpe_video_plane_display_dmabuf_export*);
 
+/**
+ * wpe_video_plane_display_dmabuf_export_get_import:
+ * @dmabuf_export: (transfer none): A DMABuf export.
+ *
+ * Gets the import handle previously associated with the same underlying
+ * DMABuf using wpe_video_plane_display_dmabuf_export_set_import(). This
+ * allows receivers to reuse their imports (e.g. an `EGLImage`) when a
+ * buffer is sent again with a new file descriptor.
+ *
+ * Returns: (transfer none): The import handle, or %NULL if the buffer has
+ *   not been imported yet.
+ */
+void*
+wpe_video_plane_display_dmabuf_export_get_import(struct wpe_video_plane_display_dmabuf_export*);
+
+typedef void (*wpe_video_plane_display_dmabuf_import_destroy_notify_t)(void *import);
+
+/**
+ * wpe_video_plane_display_dmabuf_export_set_import:
+ * @dmabuf_export: (transfer none): A DMABuf export.
+ * @import: (transfer full): Handle for the receiver-side import.
+ * @destroy_notify: Function used to destroy @import.
+ *
+ * Associates the receiver-side import of the buffer with @dmabuf_export.
+ * Must be called from the `handle_dmabuf` callback of the receiver. The
+ * import is cached and returned by
+ * wpe_video_plane_display_dmabuf_export_get_import() for later exports of
+ * the same buffer; @destroy_notify is invoked once it is evicted.
+ */
+void
+wpe_video_plane_display_dmabuf_export_set_import(struct wpe_video_plane_display_dmabuf_export*, void* import,
+    wpe_video_plane_display_dmabuf_import_destroy_notify_t destroy_notify);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,8 @@
 #include "exported-image-egl.h"
 #include "initialize-egl.h"
 #include "view-backend-exportable-egl.h"
+#include "memory-pressure.h"
+#include "viewport.h"
 
 #undef __WPE_FDO_EGL_H_INSIDE__
 
@@ -37,6 +37,8 @@
 #include "version.h"
 #include "exported-buffer-shm.h"
 #include "view-backend-exportable.h"
+#include "memory-pressure.h"
+#include "viewport.h"
 
 #undef __WPE_FDO_H_INSIDE__
 
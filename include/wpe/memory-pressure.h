@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !defined(__WPE_FDO_H_INSIDE__) && !defined(__WPE_FDO_EGL_H_INSIDE__) && !defined(__WPE_FDO_SHM_H_INSIDE__) && !defined(__WPE_FDO_DMABUF_H_INSIDE__) && !defined(WPE_FDO_COMPILATION)
+#error "Only <wpe/fdo.h>, <wpe/fdo-egl.h>, <wpe/unstable/fdo-shm.h> or <wpe/unstable/fdo-dmabuf.h> can be included directly."
+#endif
+
+#ifndef __memory_pressure_h__
+#define __memory_pressure_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum wpe_fdo_trim_memory_level {
+    WPE_FDO_TRIM_MEMORY_LEVEL_MODERATE,
+    WPE_FDO_TRIM_MEMORY_LEVEL_CRITICAL,
+};
+
+/*
+ * Releases graphics resources cached by the compositor for buffers which are
+ * not exported at the moment, and asks the clients to destroy the pool buffers
+ * they are not rendering to. At the moderate level clients keep one spare
+ * buffer around, at the critical level they keep none. Clients destroy their
+ * buffers as soon as they get the request, even if they do not render again;
+ * the GL objects wrapping them, which may keep some of that memory alive in
+ * the driver, are deleted when the next frame is rendered.
+ */
+void
+wpe_fdo_trim_memory(enum wpe_fdo_trim_memory_level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __memory_pressure_h__ */
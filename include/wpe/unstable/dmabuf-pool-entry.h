@@ -36,6 +36,8 @@ extern "C" {
 #endif
 
 struct wpe_dmabuf_pool_entry;
+struct wpe_fdo_rectangle;
+struct wpe_fdo_viewport;
 
 struct wpe_dmabuf_pool_entry_init {
     uint32_t width;
@@ -61,6 +63,20 @@ wpe_dmabuf_pool_entry_set_user_data(struct wpe_dmabuf_pool_entry*, void*);
 void*
 wpe_dmabuf_pool_entry_get_user_data(struct wpe_dmabuf_pool_entry*);
 
+/* Fence to wait on before reading a committed entry, or -1 when the client did
+ * not provide one. Owned by the entry, valid until the entry is released. */
+int
+wpe_dmabuf_pool_entry_get_acquire_fence(struct wpe_dmabuf_pool_entry*);
+
+/* Transform, scale and cropping requested by the client for the committed entry. */
+void
+wpe_dmabuf_pool_entry_get_viewport(struct wpe_dmabuf_pool_entry*, struct wpe_fdo_viewport*);
+
+/* Opaque region of the committed entry, owned by the entry. n_rects is 0
+ * when the client did not declare any part of it as opaque. */
+const struct wpe_fdo_rectangle*
+wpe_dmabuf_pool_entry_get_opaque_region(struct wpe_dmabuf_pool_entry*, uint32_t* n_rects);
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,5 +34,7 @@
 #include "dmabuf-pool-entry.h"
 #include "initialize-dmabuf.h"
 #include "view-backend-dmabuf-pool-fdo.h"
+#include "../memory-pressure.h"
+#include "../viewport.h"
 
 #undef __WPE_FDO_DMABUF_H_INSIDE__
@@ -34,6 +34,8 @@
 
 #include "../exported-buffer-shm.h"
 #include "initialize-shm.h"
+#include "../memory-pressure.h"
+#include "../viewport.h"
 
 #undef __WPE_FDO_SHM_H_INSIDE__
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __frame_timing_h__
+#define __frame_timing_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct wpe_renderer_backend_egl_target;
+struct wpe_fdo_shm_target;
+
+/*
+ * Display timing of the next frame, as last sent by the embedder with
+ * wpe_view_backend_exportable_fdo_dispatch_frame_timing(). Times are
+ * CLOCK_MONOTONIC in nanoseconds; refresh_interval is 0 when unknown.
+ * Rendering only needs to start early enough for the frame to be committed
+ * before the deadline.
+ */
+struct wpe_fdo_frame_timing {
+    uint64_t refresh_interval;
+    uint64_t presentation_time;
+    uint64_t deadline;
+};
+
+/* Return false if the host has not provided any frame timing. The values are
+ * updated before frame_complete is dispatched. */
+bool
+wpe_fdo_renderer_backend_egl_target_get_frame_timing(struct wpe_renderer_backend_egl_target*, struct wpe_fdo_frame_timing*);
+
+bool
+wpe_fdo_shm_target_get_frame_timing(struct wpe_fdo_shm_target*, struct wpe_fdo_frame_timing*);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __frame_timing_h__ */
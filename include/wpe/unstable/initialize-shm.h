@@ -39,6 +39,12 @@ extern "C" {
 bool
 wpe_fdo_initialize_shm(void);
 
+/* Like wpe_fdo_initialize_shm(), additionally exporting shm buffers as
+ * dma-bufs through /dev/udmabuf where possible. Falls back to plain shm
+ * buffers when the device is not available. */
+bool
+wpe_fdo_initialize_shm_with_udmabuf(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __partial_repaint_h__
+#define __partial_repaint_h__
+
+#define __WPE_FDO_PARTIAL_REPAINT_H_INSIDE__
+
+#include "../viewport.h"
+
+#undef __WPE_FDO_PARTIAL_REPAINT_H_INSIDE__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct wpe_renderer_backend_egl_target;
+
+/*
+ * Number of frames since the contents of the buffer being rendered into were
+ * presented, with the same meaning as EGL_EXT_buffer_age: only the damage of
+ * the last age frames needs to be repainted, and the whole buffer when it is
+ * 0. Valid between frame_will_render and frame_rendered. Targets rendering
+ * through wayland-egl always return 0; EGL_EXT_buffer_age can be queried from
+ * their EGL surface instead.
+ */
+uint32_t
+wpe_fdo_renderer_backend_egl_target_get_buffer_age(struct wpe_renderer_backend_egl_target*);
+
+/*
+ * Used instead of wpe_renderer_backend_egl_target_frame_rendered() to pass
+ * the rectangles which changed since the previous frame, in buffer
+ * coordinates, which lets the host composite only those. The whole buffer is
+ * considered damaged when n_damage is 0. Targets rendering through
+ * wayland-egl commit in eglSwapBuffers() and ignore the damage; it can be
+ * passed to eglSwapBuffersWithDamageKHR() instead.
+ */
+void
+wpe_fdo_renderer_backend_egl_target_frame_rendered_with_damage(struct wpe_renderer_backend_egl_target*, const struct wpe_fdo_rectangle* damage, uint32_t n_damage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __partial_repaint_h__ */
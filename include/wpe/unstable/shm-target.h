@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __shm_target_h__
+#define __shm_target_h__
+
+#define __WPE_FDO_SHM_TARGET_H_INSIDE__
+
+#include "../viewport.h"
+
+#undef __WPE_FDO_SHM_TARGET_H_INSIDE__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Client-side target for content rendered by the CPU, which writes frames
+ * into shared memory buffers instead of going through EGL. It is created with
+ * the renderer backend of the process and a file descriptor obtained from
+ * wpe_renderer_host_create_client(), just like EGL targets, and requires the
+ * host to have been initialized with wpe_fdo_initialize_shm().
+ */
+
+struct wpe_renderer_backend_egl;
+struct wpe_fdo_shm_target;
+
+struct wpe_fdo_shm_target_client {
+    void (*frame_complete)(void* data);
+    void (*_wpe_reserved0)(void);
+    void (*_wpe_reserved1)(void);
+    void (*_wpe_reserved2)(void);
+    void (*_wpe_reserved3)(void);
+};
+
+/*
+ * Buffer to render the next frame into. format is a wl_shm format, chosen
+ * with wpe_fdo_renderer_backend_egl_set_preferred_format(). age is the
+ * number of frames since the contents of the buffer were presented, or 0 if
+ * they are undefined: only the damage of the last age frames needs to be
+ * repainted, and the whole buffer otherwise.
+ */
+struct wpe_fdo_shm_target_buffer {
+    void* data;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t age;
+};
+
+struct wpe_fdo_shm_target*
+wpe_fdo_shm_target_create(struct wpe_renderer_backend_egl*, int host_fd, const struct wpe_fdo_shm_target_client*, void* data, uint32_t width, uint32_t height);
+
+void
+wpe_fdo_shm_target_destroy(struct wpe_fdo_shm_target*);
+
+void
+wpe_fdo_shm_target_resize(struct wpe_fdo_shm_target*, uint32_t width, uint32_t height);
+
+/* Returns false if no buffer could be allocated. Each successful call must be
+ * followed by wpe_fdo_shm_target_end_frame(). */
+bool
+wpe_fdo_shm_target_begin_frame(struct wpe_fdo_shm_target*, struct wpe_fdo_shm_target_buffer*);
+
+/* Presents the buffer, with the damaged rectangles in buffer coordinates. The
+ * whole buffer is considered damaged when n_damage is 0. */
+void
+wpe_fdo_shm_target_end_frame(struct wpe_fdo_shm_target*, const struct wpe_fdo_rectangle* damage, uint32_t n_damage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __shm_target_h__ */
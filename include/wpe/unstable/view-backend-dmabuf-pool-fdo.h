@@ -33,16 +33,21 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <wpe/wpe.h>
 
 struct wpe_dmabuf_pool_entry;
+struct wpe_view_backend_exportable_fdo_statistics;
 
 struct wpe_view_backend_dmabuf_pool_fdo_client {
     struct wpe_dmabuf_pool_entry* (*create_entry)(void*);
     void (*destroy_entry)(void*, struct wpe_dmabuf_pool_entry*);
     void (*commit_entry)(void*, struct wpe_dmabuf_pool_entry*);
 
-    void (*_wpe_reserved0)(void);
+    /* Optional; takes precedence over create_entry. The format is a DRM
+     * fourcc code the client would like to render into, or 0 when it has
+     * no preference; the entry may be allocated with a different one. */
+    struct wpe_dmabuf_pool_entry* (*create_entry_with_format)(void*, uint32_t width, uint32_t height, uint32_t format);
     void (*_wpe_reserved1)(void);
     void (*_wpe_reserved2)(void);
     void (*_wpe_reserved3)(void);
@@ -63,6 +68,37 @@ wpe_view_backend_dmabuf_pool_fdo_dispatch_frame_complete(struct wpe_view_backend
 void
 wpe_view_backend_dmabuf_pool_fdo_dispatch_release_entry(struct wpe_view_backend_dmabuf_pool_fdo*, struct wpe_dmabuf_pool_entry*);
 
+/* Takes ownership of release_fence, which may be -1. */
+void
+wpe_view_backend_dmabuf_pool_fdo_dispatch_release_entry_with_fence(struct wpe_view_backend_dmabuf_pool_fdo*, struct wpe_dmabuf_pool_entry*, int release_fence);
+
+/* Takes a wpe_view_backend_exportable_fdo_presentation_mode value. */
+void
+wpe_view_backend_dmabuf_pool_fdo_set_presentation_mode(struct wpe_view_backend_dmabuf_pool_fdo*, uint32_t mode);
+
+/* See wpe_view_backend_exportable_fdo_set_render_scale_hint(). */
+void
+wpe_view_backend_dmabuf_pool_fdo_set_render_scale_hint(struct wpe_view_backend_dmabuf_pool_fdo*, float scale);
+
+/* See wpe_view_backend_exportable_fdo_set_visible(). */
+void
+wpe_view_backend_dmabuf_pool_fdo_set_visible(struct wpe_view_backend_dmabuf_pool_fdo*, bool visible);
+
+/* See wpe_view_backend_exportable_fdo_set_hidden_frame_interval(). */
+void
+wpe_view_backend_dmabuf_pool_fdo_set_hidden_frame_interval(struct wpe_view_backend_dmabuf_pool_fdo*, uint32_t interval);
+
+/* See wpe_view_backend_exportable_fdo_set_output_properties(). */
+void
+wpe_view_backend_dmabuf_pool_fdo_set_output_properties(struct wpe_view_backend_dmabuf_pool_fdo*, int32_t scale, int32_t transform);
+
+/* See wpe_view_backend_exportable_fdo_dispatch_frame_timing(). */
+void
+wpe_view_backend_dmabuf_pool_fdo_dispatch_frame_timing(struct wpe_view_backend_dmabuf_pool_fdo*, uint64_t refresh_interval, uint64_t presentation_time, uint64_t deadline);
+
+void
+wpe_view_backend_dmabuf_pool_fdo_get_statistics(struct wpe_view_backend_dmabuf_pool_fdo*, struct wpe_view_backend_exportable_fdo_statistics*);
+
 #ifdef __cplusplus
 }
 #endif
@@ -59,6 +59,14 @@ wpe_view_backend_exportable_fdo_egl_dispatch_release_image(struct wpe_view_backe
 void
 wpe_view_backend_exportable_fdo_egl_dispatch_release_exported_image(struct wpe_view_backend_exportable_fdo*, struct wpe_fdo_egl_exported_image*);
 
+/*
+ * Releases an exported image along with a fence which signals once the
+ * embedder is done sampling from it. Ownership of the fence fd is transferred,
+ * and -1 may be passed when no fence is needed.
+ */
+void
+wpe_view_backend_exportable_fdo_egl_dispatch_release_exported_image_with_fence(struct wpe_view_backend_exportable_fdo*, struct wpe_fdo_egl_exported_image*, int release_fence);
+
 void
 wpe_view_backend_exportable_fdo_egl_dispatch_release_shm_exported_buffer(struct wpe_view_backend_exportable_fdo*, struct wpe_fdo_shm_exported_buffer*);
 
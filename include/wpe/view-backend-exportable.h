@@ -30,6 +30,7 @@
 #ifndef __view_backend_exportable_h__
 #define __view_backend_exportable_h__
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -38,7 +39,9 @@ extern "C" {
 
 struct wl_resource;
 
+struct wpe_fdo_rectangle;
 struct wpe_fdo_shm_exported_buffer;
+struct wpe_fdo_viewport;
 struct wpe_view_backend_exportable_fdo;
 
 struct wpe_view_backend_exportable_fdo_dmabuf_resource {
@@ -51,13 +54,81 @@ struct wpe_view_backend_exportable_fdo_dmabuf_resource {
     uint32_t strides[4];
     uint32_t offsets[4];
     uint64_t modifiers[4];
+    /* Fence to wait on before reading the buffer, or -1 when the client did
+     * not provide one. Owned by the library, valid until the buffer is
+     * released. */
+    int acquire_fence;
+};
+
+/*
+ * How committed frames are handed to the embedder.
+ *
+ * FIFO: every commit is exported right away, and the client waits for the
+ * embedder to call dispatch_frame_complete before rendering the next frame.
+ *
+ * MAILBOX: frame callbacks are sent as soon as a buffer is committed, so the
+ * client keeps rendering. Only the newest committed buffer is exported when
+ * the embedder calls dispatch_frame_complete, and buffers superseded before
+ * that are released back to the client right away.
+ */
+enum wpe_view_backend_exportable_fdo_presentation_mode {
+    WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_FIFO,
+    WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_MAILBOX,
+};
+
+/*
+ * Frame statistics of a view backend. Counters are monotonic since the
+ * creation of the view backend, except for buffers_held, egl_images_live and
+ * shm_bytes_mapped, which describe the current state. egl_images_live is
+ * process-wide, as EGLImages may be shared among views. Latencies measure
+ * the time from a buffer being committed by the client until the embedder
+ * releases it, in microseconds, including the time spent waiting to be
+ * exported, and follow recently released buffers. Buffers superseded before
+ * being exported are not sampled.
+ */
+struct wpe_view_backend_exportable_fdo_statistics {
+    uint64_t frames_committed;
+    uint64_t frames_exported;
+    uint64_t frames_released;
+    uint64_t frame_callbacks_dispatched;
+    uint32_t buffers_held;
+    uint32_t egl_images_live;
+    uint64_t shm_bytes_mapped;
+    uint64_t commit_to_release_latency_p50;
+    uint64_t commit_to_release_latency_p99;
+};
+
+/*
+ * Sub-surface of the view, which the embedder may present on its own plane.
+ * dmabuf_resource is NULL unless the buffer is a dma-buf. z_order is relative
+ * to the main surface of the view: negative below it, positive above. The
+ * damage rectangle covers the changes since the previous layer list, in
+ * surface coordinates, and is empty when the layer did not change.
+ *
+ * Layer buffers are owned by the library and must not be released by the
+ * embedder. A buffer stays valid until dispatch_frame_complete is called after
+ * the layers_updated notification which replaced it.
+ */
+struct wpe_view_backend_exportable_fdo_layer {
+    struct wl_resource* buffer_resource;
+    const struct wpe_view_backend_exportable_fdo_dmabuf_resource* dmabuf_resource;
+    int32_t x;
+    int32_t y;
+    int32_t z_order;
+    struct {
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+    } damage;
 };
 
 struct wpe_view_backend_exportable_fdo_client {
     void (*export_buffer_resource)(void* data, struct wl_resource* buffer_resource);
     void (*export_dmabuf_resource)(void* data, struct wpe_view_backend_exportable_fdo_dmabuf_resource* dmabuf_resource);
     void (*export_shm_buffer)(void* data, struct wpe_fdo_shm_exported_buffer*);
-    void (*_wpe_reserved0)(void);
+    /* Optional, invoked when the layer list changes. */
+    void (*layers_updated)(void* data);
     void (*_wpe_reserved1)(void);
 };
 
@@ -76,9 +147,102 @@ wpe_view_backend_exportable_fdo_dispatch_frame_complete(struct wpe_view_backend_
 void
 wpe_view_backend_exportable_fdo_dispatch_release_buffer(struct wpe_view_backend_exportable_fdo*, struct wl_resource*);
 
+/*
+ * Releases a buffer along with a fence which signals once the embedder is done
+ * reading from it. Ownership of the fence fd is transferred, and -1 may be
+ * passed when no fence is needed.
+ */
+void
+wpe_view_backend_exportable_fdo_dispatch_release_buffer_with_fence(struct wpe_view_backend_exportable_fdo*, struct wl_resource*, int release_fence);
+
 void
 wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(struct wpe_view_backend_exportable_fdo*, struct wpe_fdo_shm_exported_buffer*);
 
+/*
+ * Selects the presentation mode of the view, FIFO by default. Meant to be
+ * called right after creating the view backend.
+ */
+void
+wpe_view_backend_exportable_fdo_set_presentation_mode(struct wpe_view_backend_exportable_fdo*, enum wpe_view_backend_exportable_fdo_presentation_mode);
+
+void
+wpe_view_backend_exportable_fdo_get_statistics(struct wpe_view_backend_exportable_fdo*, struct wpe_view_backend_exportable_fdo_statistics*);
+
+/*
+ * Gets the transform, scale and cropping requested by the client for an exported
+ * buffer resource, including those exported as dma-buf resources. Returns
+ * false if the buffer is not currently exported.
+ */
+bool
+wpe_view_backend_exportable_fdo_get_buffer_viewport(struct wpe_view_backend_exportable_fdo*, struct wl_resource*, struct wpe_fdo_viewport*);
+
+/*
+ * Gets the opaque region of an exported buffer resource, valid until the
+ * buffer is released. Returns NULL, with n_rects set to 0, when the client
+ * declared no part of the buffer as opaque.
+ */
+const struct wpe_fdo_rectangle*
+wpe_view_backend_exportable_fdo_get_buffer_opaque_region(struct wpe_view_backend_exportable_fdo*, struct wl_resource*, uint32_t* n_rects);
+
+/*
+ * Suggests a render scale to the client, relative to the size of the view, as
+ * a wp_fractional_scale_v1 preferred scale. A scale below 1.0 lets the client
+ * render at a lower resolution and set a wp_viewport destination size, for
+ * the embedder to upscale the exported buffers. Defaults to 1.0.
+ */
+void
+wpe_view_backend_exportable_fdo_set_render_scale_hint(struct wpe_view_backend_exportable_fdo*, float scale);
+
+/*
+ * Marks the view as visible or hidden, visible by default. While hidden,
+ * committed buffers are not exported: the newest one is held and exported
+ * once the view is shown again, and those it supersedes are released to the
+ * client right away. Frame callbacks are then paced by the hidden frame
+ * interval instead of dispatch_frame_complete, so hidden views neither stall
+ * the client nor keep it rendering at full rate.
+ */
+void
+wpe_view_backend_exportable_fdo_set_visible(struct wpe_view_backend_exportable_fdo*, bool visible);
+
+/*
+ * Interval between frame callbacks while the view is hidden, in
+ * milliseconds. Zero stops frame callbacks until the view is visible again.
+ * Defaults to 1000.
+ */
+void
+wpe_view_backend_exportable_fdo_set_hidden_frame_interval(struct wpe_view_backend_exportable_fdo*, uint32_t interval);
+
+/*
+ * Advertises the integer scale and the transform (a wl_output_transform
+ * value) of the display the view is presented on, so the client can render
+ * buffers which need neither resampling nor rotation. Each view is a wl_output
+ * of its own for the client, so views of the same client may be given
+ * different properties. The buffer scale and transform the client applied are
+ * reported along with each exported buffer, see struct wpe_fdo_viewport.
+ */
+void
+wpe_view_backend_exportable_fdo_set_output_properties(struct wpe_view_backend_exportable_fdo*, int32_t scale, int32_t transform);
+
+/*
+ * Tells the client when the display expects the next frame, to be called from
+ * the vsync handler of the embedder before dispatch_frame_complete. Times are
+ * CLOCK_MONOTONIC in nanoseconds: the refresh interval of the display, 0 if
+ * unknown, when the next frame is expected to be presented, and the deadline
+ * for the client to commit it to make that presentation. The client can then
+ * start rendering just in time instead of right after the frame callback.
+ */
+void
+wpe_view_backend_exportable_fdo_dispatch_frame_timing(struct wpe_view_backend_exportable_fdo*, uint64_t refresh_interval, uint64_t presentation_time, uint64_t deadline);
+
+/*
+ * Returns the current layers of the view, bottom to top, which the embedder
+ * composites along with the exported buffers of the main surface. The array
+ * is owned by the library and valid until the next layers_updated
+ * notification.
+ */
+const struct wpe_view_backend_exportable_fdo_layer*
+wpe_view_backend_exportable_fdo_get_layers(struct wpe_view_backend_exportable_fdo*, uint32_t* n_layers);
+
 #ifdef __cplusplus
 }
 #endif
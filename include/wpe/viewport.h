@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !defined(__WPE_FDO_H_INSIDE__) && !defined(__WPE_FDO_EGL_H_INSIDE__) && !defined(__WPE_FDO_SHM_H_INSIDE__) && !defined(__WPE_FDO_DMABUF_H_INSIDE__) && !defined(__WPE_FDO_SHM_TARGET_H_INSIDE__) && !defined(__WPE_FDO_PARTIAL_REPAINT_H_INSIDE__) && !defined(WPE_FDO_COMPILATION)
+#error "Only <wpe/fdo.h>, <wpe/fdo-egl.h>, <wpe/unstable/fdo-shm.h>, <wpe/unstable/fdo-dmabuf.h>, <wpe/unstable/shm-target.h> or <wpe/unstable/partial-repaint.h> can be included directly."
+#endif
+
+#ifndef __viewport_h__
+#define __viewport_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * How the client requested an exported buffer to be presented. The buffer
+ * transform (a wl_output_transform value) applies first, then the contents
+ * are divided by the buffer scale, and finally cropped and scaled as set
+ * through wp_viewporter.
+ *
+ * When has_source is set, only the source rectangle is to be presented, in
+ * the coordinates resulting from the transform and scale. When set, the
+ * destination size is the size at which the contents are to be presented, in
+ * view coordinates; otherwise it is zero, and the size of the source is used.
+ */
+struct wpe_fdo_viewport {
+    int32_t buffer_scale;
+    int32_t buffer_transform;
+    bool has_source;
+    float source_x;
+    float source_y;
+    float source_width;
+    float source_height;
+    int32_t destination_width;
+    int32_t destination_height;
+};
+
+/*
+ * Rectangle in view coordinates, used to describe the opaque region of an
+ * exported buffer: the area where its contents need no blending.
+ */
+struct wpe_fdo_rectangle {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __viewport_h__ */
@@ -26,13 +26,18 @@
 #pragma once
 
 #include "wpe/unstable/dmabuf-pool-entry.h"
+#include "wpe/viewport.h"
 
 #include <array>
+#include <vector>
 
 struct wl_resource;
 
 struct wpe_dmabuf_pool_entry {
     struct wl_resource* bufferResource { nullptr };
+    int acquireFence { -1 };
+    struct wpe_fdo_viewport viewport { };
+    std::vector<struct wpe_fdo_rectangle> opaqueRegion;
 
     void* data { nullptr };
 
@@ -25,6 +25,8 @@
 
 #include "dmabuf-pool-entry-private.h"
 
+#include <unistd.h>
+
 extern "C" {
 
 __attribute__((visibility("default")))
@@ -53,6 +55,8 @@ __attribute__((visibility("default")))
 void
 wpe_dmabuf_pool_entry_destroy(struct wpe_dmabuf_pool_entry* entry)
 {
+    if (entry->acquireFence != -1)
+        close(entry->acquireFence);
     delete entry;
 }
 
@@ -70,4 +74,26 @@ wpe_dmabuf_pool_entry_get_user_data(struct wpe_dmabuf_pool_entry* entry)
     return entry->data;
 }
 
+__attribute__((visibility("default")))
+int
+wpe_dmabuf_pool_entry_get_acquire_fence(struct wpe_dmabuf_pool_entry* entry)
+{
+    return entry->acquireFence;
+}
+
+__attribute__((visibility("default")))
+void
+wpe_dmabuf_pool_entry_get_viewport(struct wpe_dmabuf_pool_entry* entry, struct wpe_fdo_viewport* viewport)
+{
+    *viewport = entry->viewport;
+}
+
+__attribute__((visibility("default")))
+const struct wpe_fdo_rectangle*
+wpe_dmabuf_pool_entry_get_opaque_region(struct wpe_dmabuf_pool_entry* entry, uint32_t* n_rects)
+{
+    *n_rects = entry->opaqueRegion.size();
+    return entry->opaqueRegion.empty() ? nullptr : entry->opaqueRegion.data();
+}
+
 } // extern "C"
@@ -26,9 +26,12 @@
 #include "egl-client-dmabuf-pool.h"
 
 #include "ws-client.h"
+#include "ws-tracing.h"
 
 #include <array>
 #include <cstdio>
+#include <initializer_list>
+#include <unistd.h>
 
 namespace WS {
 namespace EGLClient {
@@ -54,6 +57,11 @@ struct TargetDmabufPool::Buffer {
     struct wl_list link;
     struct wl_buffer* buffer { nullptr };
     bool locked { false };
+    // Frames since the buffer was last committed, 0 if never.
+    uint32_t age { 0 };
+
+    struct zwp_linux_buffer_release_v1* release { nullptr };
+    int releaseFence { -1 };
 
     struct {
         uint32_t width;
@@ -124,6 +132,7 @@ void TargetDmabufPool::frameWillRender()
 {
     if (!m_renderer.initialized) {
         m_renderer.initialized = true;
+        m_renderer.display = eglGetCurrentDisplay();
 
         m_renderer.createImageKHR = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
             eglGetProcAddress("eglCreateImageKHR"));
@@ -135,24 +144,48 @@ void TargetDmabufPool::frameWillRender()
         GLuint framebuffer { 0 };
         glGenFramebuffers(1, &framebuffer);
         m_renderer.framebuffer = framebuffer;
+
+        if (m_base.surfaceSynchronization() && epoxy_has_egl_extension(eglGetCurrentDisplay(), "EGL_ANDROID_native_fence_sync")) {
+            m_renderer.nativeFenceSync = true;
+            m_renderer.createSyncKHR = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+                eglGetProcAddress("eglCreateSyncKHR"));
+            m_renderer.destroySyncKHR = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+                eglGetProcAddress("eglDestroySyncKHR"));
+            m_renderer.waitSyncKHR = reinterpret_cast<PFNEGLWAITSYNCKHRPROC>(
+                eglGetProcAddress("eglWaitSyncKHR"));
+            m_renderer.dupNativeFenceFDANDROID = reinterpret_cast<PFNEGLDUPNATIVEFENCEFDANDROIDPROC>(
+                eglGetProcAddress("eglDupNativeFenceFDANDROID"));
+        }
     }
 
     m_base.requestFrame();
 
     g_assert(!m_buffer.current);
+    deleteTrimmedRenderbuffers();
     {
+        // The host returns buffers intact, so the most recently presented one
+        // needs the least repainting.
         Buffer* b;
         wl_list_for_each(b, &m_buffer.list, link) {
             if (b->locked)
                 continue;
 
-            m_buffer.current = b;
-            break;
+            if (!m_buffer.current || (b->age && (!m_buffer.current->age || b->age < m_buffer.current->age)))
+                m_buffer.current = b;
         }
     }
+    if (m_buffer.current)
+        waitForReleaseFence(*m_buffer.current);
     if (!m_buffer.current) {
+        WS_TRACE_MARK("allocateBuffer", m_base.bridgeId(), m_base.frameSequence());
         auto* buffer = new Buffer;
-        buffer->buffer = wpe_dmabuf_pool_create_buffer(m_base.wpeDmabufPool(), m_renderer.width, m_renderer.height);
+        // The host may allocate a different format than the requested one;
+        // the image is created from whatever the dmabuf data reports.
+        uint32_t format = m_base.preferredFormat();
+        if (format && wl_proxy_get_version(reinterpret_cast<struct wl_proxy*>(m_base.wpeDmabufPool())) >= WPE_DMABUF_POOL_CREATE_BUFFER_WITH_FORMAT_SINCE_VERSION)
+            buffer->buffer = wpe_dmabuf_pool_create_buffer_with_format(m_base.wpeDmabufPool(), m_renderer.width, m_renderer.height, format);
+        else
+            buffer->buffer = wpe_dmabuf_pool_create_buffer(m_base.wpeDmabufPool(), m_renderer.width, m_renderer.height);
         wl_buffer_add_listener(buffer->buffer, &s_bufferListener, this);
 
         wl_list_insert(&m_buffer.list, &buffer->link);
@@ -280,17 +313,46 @@ void TargetDmabufPool::frameWillRender()
         g_warning("established framebuffer object is not framebuffer-complete");
 }
 
-void TargetDmabufPool::frameRendered()
+void TargetDmabufPool::frameRendered(const struct wpe_fdo_rectangle* damage, uint32_t damageCount)
 {
-    glFlush();
+    if (m_renderer.nativeFenceSync) {
+        int fence = createAcquireFence();
+        if (fence != -1) {
+            zwp_linux_surface_synchronization_v1_set_acquire_fence(m_base.surfaceSynchronization(), fence);
+            close(fence);
+        }
+
+        if (!m_buffer.current->release) {
+            m_buffer.current->release = zwp_linux_surface_synchronization_v1_get_release(m_base.surfaceSynchronization());
+            zwp_linux_buffer_release_v1_add_listener(m_buffer.current->release, &s_bufferReleaseListener, m_buffer.current);
+        }
+    } else
+        glFlush();
 
     wl_surface_attach(m_base.surface(), m_buffer.current->buffer, 0, 0);
+    m_base.damageBuffer(damage, damageCount);
     wl_surface_commit(m_base.surface());
 
+    Buffer* buffer;
+    wl_list_for_each(buffer, &m_buffer.list, link) {
+        if (buffer->age)
+            ++buffer->age;
+    }
+    m_buffer.current->age = 1;
     m_buffer.current->locked = true;
     m_buffer.current = nullptr;
 }
 
+uint32_t TargetDmabufPool::bufferAge() const
+{
+    return m_buffer.current ? m_buffer.current->age : 0;
+}
+
+void TargetDmabufPool::trimMemory(TrimMemoryLevel level)
+{
+    destroyUnlockedBuffers(level);
+}
+
 void TargetDmabufPool::deinitialize()
 {
     m_buffer.current = nullptr;
@@ -302,6 +364,7 @@ void TargetDmabufPool::deinitialize()
         destroyBuffer(buffer);
     }
     wl_list_init(&m_buffer.list);
+    deleteTrimmedRenderbuffers();
 
     if (m_renderer.framebuffer) {
         glDeleteFramebuffers(1, &m_renderer.framebuffer);
@@ -309,20 +372,96 @@ void TargetDmabufPool::deinitialize()
     }
 }
 
+void TargetDmabufPool::waitForReleaseFence(Buffer& buffer)
+{
+    if (buffer.releaseFence == -1)
+        return;
+
+    // The sync object takes ownership of the fence fd when created successfully.
+    EGLint attributes[] = { EGL_SYNC_NATIVE_FENCE_FD_ANDROID, buffer.releaseFence, EGL_NONE };
+    EGLSyncKHR sync = m_renderer.createSyncKHR(eglGetCurrentDisplay(), EGL_SYNC_NATIVE_FENCE_ANDROID, attributes);
+    if (sync != EGL_NO_SYNC_KHR) {
+        m_renderer.waitSyncKHR(eglGetCurrentDisplay(), sync, 0);
+        m_renderer.destroySyncKHR(eglGetCurrentDisplay(), sync);
+    } else
+        close(buffer.releaseFence);
+    buffer.releaseFence = -1;
+}
+
+int TargetDmabufPool::createAcquireFence()
+{
+    EGLSyncKHR sync = m_renderer.createSyncKHR(eglGetCurrentDisplay(), EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+    if (sync == EGL_NO_SYNC_KHR) {
+        glFlush();
+        return -1;
+    }
+
+    // The native fence only materializes once the commands are flushed.
+    glFlush();
+    int fence = m_renderer.dupNativeFenceFDANDROID(eglGetCurrentDisplay(), sync);
+    m_renderer.destroySyncKHR(eglGetCurrentDisplay(), sync);
+    return fence == EGL_NO_NATIVE_FENCE_FD_ANDROID ? -1 : fence;
+}
+
 void TargetDmabufPool::destroyBuffer(Buffer* buffer)
 {
     auto& b = *buffer;
+    g_clear_pointer(&b.release, zwp_linux_buffer_release_v1_destroy);
+    if (b.releaseFence != -1)
+        close(b.releaseFence);
     g_clear_pointer(&b.buffer, wl_buffer_destroy);
     if (b.gl.colorBuffer)
         glDeleteRenderbuffers(1, &b.gl.colorBuffer);
     if (b.gl.dsBuffer)
         glDeleteRenderbuffers(1, &b.gl.dsBuffer);
     if (b.egl.image)
-        m_renderer.destroyImageKHR(eglGetCurrentDisplay(), b.egl.image);
+        m_renderer.destroyImageKHR(m_renderer.display, b.egl.image);
 
     delete buffer;
 }
 
+void TargetDmabufPool::destroyUnlockedBuffers(TrimMemoryLevel level)
+{
+    // On the moderate level a spare buffer is kept, so the next frame does
+    // not need to allocate a new one.
+    bool keepSpare = level == TrimMemoryLevel::Moderate;
+
+    // Views which do not render may never make the rendering context current
+    // again: everything but the renderbuffers goes away right now, so the host
+    // can free the pool entries.
+
+    Buffer* buffer;
+    Buffer* tmp;
+    wl_list_for_each_safe(buffer, tmp, &m_buffer.list, link) {
+        if (buffer->locked)
+            continue;
+
+        if (keepSpare) {
+            keepSpare = false;
+            continue;
+        }
+
+        WS_TRACE_MARK("destroyBuffer", m_base.bridgeId(), m_base.frameSequence());
+        for (GLuint* renderbuffer : { &buffer->gl.colorBuffer, &buffer->gl.dsBuffer }) {
+            if (*renderbuffer)
+                m_trim.renderbuffers.push_back(*renderbuffer);
+            *renderbuffer = 0;
+        }
+
+        wl_list_remove(&buffer->link);
+        destroyBuffer(buffer);
+    }
+}
+
+void TargetDmabufPool::deleteTrimmedRenderbuffers()
+{
+    if (m_trim.renderbuffers.empty())
+        return;
+
+    glDeleteRenderbuffers(m_trim.renderbuffers.size(), m_trim.renderbuffers.data());
+    m_trim.renderbuffers.clear();
+}
+
 const struct wpe_dmabuf_data_listener TargetDmabufPool::s_dmabufDataListener = {
     // atributes
     [](void* data, struct wpe_dmabuf_data*, uint32_t width, uint32_t height, uint32_t format, uint32_t num_planes)
@@ -366,4 +505,25 @@ const struct wl_buffer_listener TargetDmabufPool::s_bufferListener = {
     }
 };
 
+const struct zwp_linux_buffer_release_v1_listener TargetDmabufPool::s_bufferReleaseListener = {
+    // fenced_release
+    [](void* data, struct zwp_linux_buffer_release_v1* release, int32_t fence)
+    {
+        auto& buffer = *static_cast<Buffer*>(data);
+        g_assert(buffer.release == release);
+        g_clear_pointer(&buffer.release, zwp_linux_buffer_release_v1_destroy);
+
+        if (buffer.releaseFence != -1)
+            close(buffer.releaseFence);
+        buffer.releaseFence = fence;
+    },
+    // immediate_release
+    [](void* data, struct zwp_linux_buffer_release_v1* release)
+    {
+        auto& buffer = *static_cast<Buffer*>(data);
+        g_assert(buffer.release == release);
+        g_clear_pointer(&buffer.release, zwp_linux_buffer_release_v1_destroy);
+    },
+};
+
 } } // namespace WS::EGLClient
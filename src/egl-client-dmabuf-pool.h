@@ -28,6 +28,7 @@
 #include "egl-client.h"
 #include "wpe-dmabuf-pool-client-protocol.h"
 #include <epoxy/egl.h>
+#include <vector>
 #include <wayland-client.h>
 
 namespace WS {
@@ -52,7 +53,11 @@ public:
     void resize(uint32_t width, uint32_t height) override;
 
     void frameWillRender() override;
-    void frameRendered() override;
+    void frameRendered(const struct wpe_fdo_rectangle*, uint32_t) override;
+
+    uint32_t bufferAge() const override;
+
+    void trimMemory(TrimMemoryLevel) override;
 
     void deinitialize() override;
 
@@ -61,26 +66,46 @@ private:
 
     static const struct wpe_dmabuf_data_listener s_dmabufDataListener;
     static const struct wl_buffer_listener s_bufferListener;
+    static const struct zwp_linux_buffer_release_v1_listener s_bufferReleaseListener;
 
     struct {
         bool initialized { false };
         uint32_t width { 0 };
         uint32_t height { 0 };
 
+        // Display of the rendering context, which images are created on.
+        EGLDisplay display { EGL_NO_DISPLAY };
         PFNEGLCREATEIMAGEKHRPROC createImageKHR;
         PFNEGLDESTROYIMAGEKHRPROC destroyImageKHR;
         PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC imageTargetRenderbufferStorageOES;
 
+        // EGL_ANDROID_native_fence_sync, used for explicit synchronization.
+        bool nativeFenceSync { false };
+        PFNEGLCREATESYNCKHRPROC createSyncKHR;
+        PFNEGLDESTROYSYNCKHRPROC destroySyncKHR;
+        PFNEGLWAITSYNCKHRPROC waitSyncKHR;
+        PFNEGLDUPNATIVEFENCEFDANDROIDPROC dupNativeFenceFDANDROID;
+
         GLuint framebuffer { 0 };
     } m_renderer;
 
     struct Buffer;
     void destroyBuffer(Buffer*);
+    void destroyUnlockedBuffers(TrimMemoryLevel);
+    void deleteTrimmedRenderbuffers();
+    void waitForReleaseFence(Buffer&);
+    int createAcquireFence();
 
     struct {
         Buffer* current { nullptr };
         struct wl_list list;
     } m_buffer;
+
+    struct {
+        // Renderbuffers of trimmed buffers, deleted once the rendering
+        // context is current again.
+        std::vector<GLuint> renderbuffers;
+    } m_trim;
 };
 
 } } // namespace WS::EGLClient
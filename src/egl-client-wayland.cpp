@@ -76,8 +76,10 @@ void TargetWayland::frameWillRender()
     m_base.requestFrame();
 }
 
-void TargetWayland::frameRendered()
+void TargetWayland::frameRendered(const struct wpe_fdo_rectangle*, uint32_t)
 {
+    // The buffer was already committed by eglSwapBuffers(), along with the
+    // damage passed to eglSwapBuffersWithDamageKHR(), if used.
 }
 
 void TargetWayland::deinitialize()
@@ -54,7 +54,7 @@ public:
     void resize(uint32_t width, uint32_t height) override;
 
     void frameWillRender() override;
-    void frameRendered() override;
+    void frameRendered(const struct wpe_fdo_rectangle*, uint32_t) override;
 
     void deinitialize() override;
 
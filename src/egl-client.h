@@ -25,9 +25,12 @@
 
 #pragma once
 
+#include "ws-types.h"
 #include <epoxy/egl.h>
 #include <memory>
 
+struct wpe_fdo_rectangle;
+
 namespace WS {
 
 class BaseBackend;
@@ -64,7 +67,16 @@ public:
     virtual void resize(uint32_t width, uint32_t height) = 0;
 
     virtual void frameWillRender() = 0;
-    virtual void frameRendered() = 0;
+    // Damage is in buffer coordinates; none means the whole buffer changed.
+    virtual void frameRendered(const struct wpe_fdo_rectangle* damage, uint32_t damageCount) = 0;
+
+    // Frames since the contents of the buffer being rendered were presented,
+    // or 0 if unknown, as with EGL_EXT_buffer_age.
+    virtual uint32_t bufferAge() const { return 0; }
+
+    // Releases cached buffers right away, as the view may not render again;
+    // only what needs the rendering context waits until the next frame.
+    virtual void trimMemory(TrimMemoryLevel) { }
 
     virtual void deinitialize() = 0;
 };
@@ -25,10 +25,33 @@
 
 #pragma once
 
-struct wl_resource;
-struct wl_shm_buffer;
+#include "../include/wpe/exported-buffer-shm.h"
+#include "../include/wpe/viewport.h"
+#include <cstddef>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include <wayland-server.h>
 
 struct wpe_fdo_shm_exported_buffer {
     struct wl_resource* resource;
     struct wl_shm_buffer* shm_buffer;
+    size_t size;
+    struct wpe_fdo_viewport viewport;
+    std::vector<struct wpe_fdo_rectangle> opaqueRegion;
+    struct wpe_fdo_shm_dmabuf_attributes dmabuf { -1 };
+
+    // Contents of the buffer, kept mapped until the buffer is released either
+    // through a mapping of sealed memory, or through a reference on the pool.
+    const void* data { nullptr };
+    std::shared_ptr<const void> mapping;
+    struct wl_shm_pool* pool { nullptr };
+
+    ~wpe_fdo_shm_exported_buffer()
+    {
+        if (dmabuf.fd != -1)
+            close(dmabuf.fd);
+        if (pool)
+            wl_shm_pool_unref(pool);
+    }
 };
@@ -41,4 +41,38 @@ wpe_fdo_shm_exported_buffer_get_shm_buffer(struct wpe_fdo_shm_exported_buffer* b
     return buffer->shm_buffer;
 }
 
+__attribute__((visibility("default")))
+void
+wpe_fdo_shm_exported_buffer_get_viewport(struct wpe_fdo_shm_exported_buffer* buffer, struct wpe_fdo_viewport* viewport)
+{
+    *viewport = buffer->viewport;
+}
+
+__attribute__((visibility("default")))
+const struct wpe_fdo_rectangle*
+wpe_fdo_shm_exported_buffer_get_opaque_region(struct wpe_fdo_shm_exported_buffer* buffer, uint32_t* n_rects)
+{
+    *n_rects = buffer->opaqueRegion.size();
+    return buffer->opaqueRegion.empty() ? nullptr : buffer->opaqueRegion.data();
+}
+
+__attribute__((visibility("default")))
+bool
+wpe_fdo_shm_exported_buffer_get_dmabuf_attributes(struct wpe_fdo_shm_exported_buffer* buffer, struct wpe_fdo_shm_dmabuf_attributes* attributes)
+{
+    if (buffer->dmabuf.fd == -1)
+        return false;
+
+    *attributes = buffer->dmabuf;
+    return true;
+}
+
+__attribute__((visibility("default")))
+const void*
+wpe_fdo_shm_exported_buffer_get_data(struct wpe_fdo_shm_exported_buffer* buffer, bool* guarded)
+{
+    *guarded = !buffer->mapping;
+    return buffer->data;
+}
+
 }
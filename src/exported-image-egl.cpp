@@ -52,4 +52,26 @@ wpe_fdo_egl_exported_image_get_egl_image(struct wpe_fdo_egl_exported_image* imag
     return image->eglImage;
 }
 
+__attribute__((visibility("default")))
+int
+wpe_fdo_egl_exported_image_get_acquire_fence(struct wpe_fdo_egl_exported_image* image)
+{
+    return image->acquireFence;
+}
+
+__attribute__((visibility("default")))
+void
+wpe_fdo_egl_exported_image_get_viewport(struct wpe_fdo_egl_exported_image* image, struct wpe_fdo_viewport* viewport)
+{
+    *viewport = image->viewport;
+}
+
+__attribute__((visibility("default")))
+const struct wpe_fdo_rectangle*
+wpe_fdo_egl_exported_image_get_opaque_region(struct wpe_fdo_egl_exported_image* image, uint32_t* n_rects)
+{
+    *n_rects = image->opaqueRegion.size();
+    return image->opaqueRegion.empty() ? nullptr : image->opaqueRegion.data();
+}
+
 }
@@ -26,140 +26,21 @@
 #include "../../include/wpe/extensions/audio.h"
 
 #include "../ws-client.h"
+#include "io-thread.h"
 #include "wpe-audio-client-protocol.h"
 #include <wpe/wpe-egl.h>
-#include <cstring>
 
 namespace Impl {
 
-class AudioThread {
-public:
-    static AudioThread& singleton();
-    static void initialize(struct wl_display*);
-
-    struct wl_event_queue* eventQueue() const { return m_wl.eventQueue; }
-
-private:
-    static AudioThread* s_thread;
-    static gpointer s_threadEntrypoint(gpointer);
-
-    AudioThread(struct wl_display*);
-
-    struct ThreadSpawn {
-        GMutex mutex;
-        GCond cond;
-        AudioThread* thread;
-    };
-
-    struct {
-        struct wl_display* display;
-        struct wl_event_queue* eventQueue;
-    } m_wl;
-
-    struct {
-        GThread* thread;
-        GSource* wlSource;
-    } m_glib;
-};
-
-AudioThread* AudioThread::s_thread = nullptr;
-
-AudioThread& AudioThread::singleton()
-{
-    return *s_thread;
-}
-
-void AudioThread::initialize(struct wl_display* display)
-{
-    if (s_thread) {
-        if (s_thread->m_wl.display != display)
-            g_error("AudioThread: tried to reinitialize with a different wl_display object");
-    }
-
-    if (!s_thread)
-        s_thread = new AudioThread(display);
-}
-
-AudioThread::AudioThread(struct wl_display* display)
-{
-    m_wl.display = display;
-    m_wl.eventQueue = wl_display_create_queue(m_wl.display);
-
-    {
-        ThreadSpawn threadSpawn;
-        threadSpawn.thread = this;
-
-        g_mutex_init(&threadSpawn.mutex);
-        g_cond_init(&threadSpawn.cond);
-
-        g_mutex_lock(&threadSpawn.mutex);
-
-        m_glib.thread = g_thread_new("WPEBackend-fdo::audio-thread", s_threadEntrypoint, &threadSpawn);
-        g_cond_wait(&threadSpawn.cond, &threadSpawn.mutex);
-
-        g_mutex_unlock(&threadSpawn.mutex);
-
-        g_mutex_clear(&threadSpawn.mutex);
-        g_cond_clear(&threadSpawn.cond);
-    }
-}
-
-gpointer AudioThread::s_threadEntrypoint(gpointer data)
-{
-    auto& threadSpawn = *reinterpret_cast<ThreadSpawn*>(data);
-    g_mutex_lock(&threadSpawn.mutex);
-
-    auto& thread = *threadSpawn.thread;
-
-    GMainContext* context = g_main_context_new();
-    GMainLoop* loop = g_main_loop_new(context, FALSE);
-
-    g_main_context_push_thread_default(context);
-
-    thread.m_glib.wlSource = WS::ws_polling_source_new("WPEBackend-fdo::audio", thread.m_wl.display, thread.m_wl.eventQueue);
-    // The source is attached in the idle callback.
-
-    {
-        GSource* source = g_idle_source_new();
-        g_source_set_callback(source,
-            [](gpointer data) -> gboolean {
-                auto& threadSpawn = *reinterpret_cast<ThreadSpawn*>(data);
-
-                auto& thread = *threadSpawn.thread;
-                g_source_attach(thread.m_glib.wlSource, g_main_context_get_thread_default());
-
-                g_cond_signal(&threadSpawn.cond);
-                g_mutex_unlock(&threadSpawn.mutex);
-                return FALSE;
-            }, &threadSpawn, nullptr);
-        g_source_attach(source, context);
-        g_source_unref(source);
-    }
-
-    g_main_loop_run(loop);
-
-    g_main_loop_unref(loop);
-    g_main_context_pop_thread_default(context);
-    g_main_context_unref(context);
-    return nullptr;
-}
-
 class Audio {
 public:
     Audio(WS::BaseBackend& backend)
     {
-        struct wl_display* display = backend.display();
-        AudioThread::initialize(display);
+        IOThread::initialize(backend.display());
 
-        struct wl_event_queue* eventQueue = wl_display_create_queue(display);
-
-        struct wl_registry* registry = wl_display_get_registry(display);
-        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(registry), eventQueue);
-        wl_registry_add_listener(registry, &s_registryListener, this);
-        wl_display_roundtrip_queue(display, eventQueue);
-        wl_registry_destroy(registry);
-
-        wl_event_queue_destroy(eventQueue);
+        // Packet exports inherit the queue, so that their release events are
+        // dispatched on the I/O thread.
+        m_wl.audio = static_cast<struct wpe_audio*>(backend.bindGlobal(&wpe_audio_interface, 1, IOThread::singleton().eventQueue()));
     }
 
     ~Audio()
@@ -181,7 +62,6 @@ public:
 
         auto* update = wpe_audio_stream_packet(m_wl.audio, id, fd, frames);
 
-        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(update), AudioThread::singleton().eventQueue());
         wpe_audio_packet_export_add_listener(update, &s_audioPacketExportListener, new ListenerData { notify, notify_data });
     }
 
@@ -209,7 +89,6 @@ public:
     }
 
 private:
-    static const struct wl_registry_listener s_registryListener;
     static const struct wpe_audio_packet_export_listener s_audioPacketExportListener;
 
     struct ListenerData {
@@ -233,18 +112,6 @@ const struct wpe_audio_packet_export_listener Audio::s_audioPacketExportListener
     },
 };
 
-const struct wl_registry_listener Audio::s_registryListener = {
-    // global
-    [](void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t)
-    {
-        auto& impl = *reinterpret_cast<Audio*>(data);
-        if (!std::strcmp(interface, "wpe_audio"))
-            impl.m_wl.audio = static_cast<struct wpe_audio*>(wl_registry_bind(registry, name, &wpe_audio_interface, 1));
-    },
-    // global_remove
-    [](void*, struct wl_registry*, uint32_t) { },
-};
-
 }
 
 extern "C" {
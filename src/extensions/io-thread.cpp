@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io-thread.h"
+
+#include "../../include/wpe/extensions/io-thread.h"
+#include "../ws-client.h"
+#include <cerrno>
+#include <mutex>
+#include <sched.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Impl {
+
+namespace {
+
+struct Settings {
+    std::mutex mutex;
+    std::string name { "WPEBackend-fdo::extensions-io" };
+    std::vector<unsigned> affinity;
+    bool hasPriority { false };
+    int priority { 0 };
+};
+
+Settings& settings()
+{
+    static Settings s_settings;
+    return s_settings;
+}
+
+}
+
+IOThread* IOThread::s_thread = nullptr;
+
+IOThread& IOThread::singleton()
+{
+    return *s_thread;
+}
+
+void IOThread::initialize(struct wl_display* display)
+{
+    if (s_thread) {
+        if (s_thread->m_wl.display != display)
+            g_error("IOThread: tried to reinitialize with a different wl_display object");
+    }
+
+    if (!s_thread)
+        s_thread = new IOThread(display);
+}
+
+void IOThread::setName(const char* name)
+{
+    std::lock_guard<std::mutex> lock(settings().mutex);
+    settings().name = name;
+}
+
+void IOThread::setAffinity(const unsigned* cpus, unsigned count)
+{
+    std::lock_guard<std::mutex> lock(settings().mutex);
+    settings().affinity.assign(cpus, cpus + count);
+    if (s_thread && s_thread->m_tid)
+        applyAffinity(s_thread->m_tid);
+}
+
+void IOThread::setPriority(int nice)
+{
+    std::lock_guard<std::mutex> lock(settings().mutex);
+    settings().hasPriority = true;
+    settings().priority = nice;
+    if (s_thread && s_thread->m_tid)
+        applyPriority(s_thread->m_tid);
+}
+
+void IOThread::applyAffinity(pid_t tid)
+{
+    // An empty set lets the thread run on any CPU again.
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (settings().affinity.empty()) {
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, &set);
+    } else {
+        for (unsigned cpu : settings().affinity) {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+    }
+
+    if (sched_setaffinity(tid, sizeof(set), &set) == -1)
+        g_warning("IOThread: failed to set the CPU affinity: %s", g_strerror(errno));
+}
+
+void IOThread::applyPriority(pid_t tid)
+{
+    if (!settings().hasPriority)
+        return;
+
+    // On Linux the nice value is a per-thread attribute.
+    if (setpriority(PRIO_PROCESS, tid, settings().priority) == -1)
+        g_warning("IOThread: failed to set the priority: %s", g_strerror(errno));
+}
+
+IOThread::IOThread(struct wl_display* display)
+{
+    m_wl.display = display;
+    m_wl.eventQueue = wl_display_create_queue(m_wl.display);
+
+    {
+        ThreadSpawn threadSpawn;
+        threadSpawn.thread = this;
+
+        g_mutex_init(&threadSpawn.mutex);
+        g_cond_init(&threadSpawn.cond);
+
+        g_mutex_lock(&threadSpawn.mutex);
+
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(settings().mutex);
+            name = settings().name;
+        }
+        m_glib.thread = g_thread_new(name.c_str(), s_threadEntrypoint, &threadSpawn);
+        g_cond_wait(&threadSpawn.cond, &threadSpawn.mutex);
+
+        g_mutex_unlock(&threadSpawn.mutex);
+
+        g_mutex_clear(&threadSpawn.mutex);
+        g_cond_clear(&threadSpawn.cond);
+    }
+}
+
+gpointer IOThread::s_threadEntrypoint(gpointer data)
+{
+    auto& threadSpawn = *reinterpret_cast<ThreadSpawn*>(data);
+    g_mutex_lock(&threadSpawn.mutex);
+
+    auto& thread = *threadSpawn.thread;
+
+    {
+        std::lock_guard<std::mutex> lock(settings().mutex);
+        thread.m_tid = static_cast<pid_t>(syscall(SYS_gettid));
+        if (!settings().affinity.empty())
+            applyAffinity(thread.m_tid);
+        applyPriority(thread.m_tid);
+    }
+
+    GMainContext* context = g_main_context_new();
+    GMainLoop* loop = g_main_loop_new(context, FALSE);
+
+    g_main_context_push_thread_default(context);
+
+    thread.m_glib.wlSource = WS::ws_polling_source_new("WPEBackend-fdo::extensions-io", thread.m_wl.display, thread.m_wl.eventQueue);
+    // The source is attached in the idle callback.
+
+    {
+        GSource* source = g_idle_source_new();
+        g_source_set_callback(source,
+            [](gpointer data) -> gboolean {
+                auto& threadSpawn = *reinterpret_cast<ThreadSpawn*>(data);
+
+                auto& thread = *threadSpawn.thread;
+                g_source_attach(thread.m_glib.wlSource, g_main_context_get_thread_default());
+
+                g_cond_signal(&threadSpawn.cond);
+                g_mutex_unlock(&threadSpawn.mutex);
+                return FALSE;
+            }, &threadSpawn, nullptr);
+        g_source_attach(source, context);
+        g_source_unref(source);
+    }
+
+    g_main_loop_run(loop);
+
+    g_main_loop_unref(loop);
+    g_main_context_pop_thread_default(context);
+    g_main_context_unref(context);
+    return nullptr;
+}
+
+} // namespace Impl
+
+extern "C" {
+
+__attribute__((visibility("default")))
+void
+wpe_extensions_io_thread_set_name(const char* name)
+{
+    Impl::IOThread::setName(name);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_extensions_io_thread_set_affinity(const unsigned* cpus, unsigned n_cpus)
+{
+    Impl::IOThread::setAffinity(cpus, n_cpus);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_extensions_io_thread_set_priority(int nice)
+{
+    Impl::IOThread::setPriority(nice);
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <wayland-client.h>
+
+namespace Impl {
+
+// Thread dispatching the events of all the client-side extensions, which
+// only need to be told when the host is done with the resources they send.
+// All of them share a single event queue, owned by the thread.
+class IOThread {
+public:
+    static IOThread& singleton();
+    static void initialize(struct wl_display*);
+
+    struct wl_event_queue* eventQueue() const { return m_wl.eventQueue; }
+
+    // Applied when the thread is started, and right away to the running
+    // thread for the affinity and priority.
+    static void setName(const char*);
+    static void setAffinity(const unsigned* cpus, unsigned count);
+    static void setPriority(int nice);
+
+private:
+    static IOThread* s_thread;
+    static gpointer s_threadEntrypoint(gpointer);
+
+    explicit IOThread(struct wl_display*);
+
+    static void applyAffinity(pid_t);
+    static void applyPriority(pid_t);
+
+    struct ThreadSpawn {
+        GMutex mutex;
+        GCond cond;
+        IOThread* thread;
+    };
+
+    struct {
+        struct wl_display* display;
+        struct wl_event_queue* eventQueue;
+    } m_wl;
+
+    struct {
+        GThread* thread;
+        GSource* wlSource;
+    } m_glib;
+
+    pid_t m_tid { 0 };
+};
+
+} // namespace Impl
@@ -63,4 +63,19 @@ wpe_video_plane_display_dmabuf_export_release(struct wpe_video_plane_display_dma
     WS::Instance::singleton().releaseVideoPlaneDisplayDmaBufExport(dmabuf_export);
 }
 
+__attribute__((visibility("default")))
+void*
+wpe_video_plane_display_dmabuf_export_get_import(struct wpe_video_plane_display_dmabuf_export* dmabuf_export)
+{
+    return WS::Instance::singleton().videoPlaneDisplayDmaBufImport(dmabuf_export);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_video_plane_display_dmabuf_export_set_import(struct wpe_video_plane_display_dmabuf_export* dmabuf_export, void* import,
+    wpe_video_plane_display_dmabuf_import_destroy_notify_t destroy_notify)
+{
+    WS::Instance::singleton().setVideoPlaneDisplayDmaBufImport(dmabuf_export, import, destroy_notify);
+}
+
 }
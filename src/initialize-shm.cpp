@@ -40,4 +40,15 @@ wpe_fdo_initialize_shm(void)
     return static_cast<WS::ImplSHM&>(instance.impl()).initialize();
 }
 
+__attribute__((visibility("default")))
+bool
+wpe_fdo_initialize_shm_with_udmabuf(void)
+{
+    if (!WS::Instance::isConstructed())
+        WS::Instance::construct(std::unique_ptr<WS::ImplSHM>(new WS::ImplSHM));
+
+    auto& instance = WS::Instance::singleton();
+    return static_cast<WS::ImplSHM&>(instance.impl()).initialize(true);
+}
+
 }
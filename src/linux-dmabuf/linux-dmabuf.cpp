@@ -80,6 +80,7 @@ destroy_wl_buffer_resource(struct wl_resource *resource)
     if (buffer->user_data_destroy_func)
         buffer->user_data_destroy_func(buffer);
 
+    WS::instanceImpl<WS::ImplEGL>().dmaBufBufferDestroyed(buffer);
     linux_dmabuf_buffer_destroy(buffer);
 }
 
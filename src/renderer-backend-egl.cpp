@@ -29,11 +29,14 @@
 
 #include <wpe/wpe-egl.h>
 
+#include "../include/wpe/unstable/frame-timing.h"
+#include "../include/wpe/unstable/partial-repaint.h"
 #include "egl-client.h"
 #include "egl-client-dmabuf-pool.h"
 #include "egl-client-wayland.h"
 #include "interfaces.h"
 #include "ws-client.h"
+#include "ws-tracing.h"
 
 namespace {
 
@@ -41,24 +44,34 @@ class Backend final : public WS::BaseBackend {
 public:
     Backend(int hostFD)
         : WS::BaseBackend(hostFD)
-    {
-        switch (type()) {
-        case WS::ClientImplementationType::Invalid:
-            g_error("Backend: invalid valid client implementation");
-            break;
-        case WS::ClientImplementationType::DmabufPool:
-            m_impl = WS::EGLClient::BackendImpl::create<WS::EGLClient::BackendDmabufPool>(*this);
-            break;
-        case WS::ClientImplementationType::Wayland:
-            m_impl = WS::EGLClient::BackendImpl::create<WS::EGLClient::BackendWayland>(*this);
-            break;
-        }
-    }
+    { }
 
     ~Backend() = default;
 
     using WS::BaseBackend::display;
 
+    // Created on first use, so that creating the backend does not wait for
+    // the host to send the implementation info.
+    WS::EGLClient::BackendImpl& impl()
+    {
+        if (!m_impl) {
+            switch (type()) {
+            case WS::ClientImplementationType::Invalid:
+                g_error("Backend: invalid valid client implementation");
+                break;
+            case WS::ClientImplementationType::DmabufPool:
+                m_impl = WS::EGLClient::BackendImpl::create<WS::EGLClient::BackendDmabufPool>(*this);
+                break;
+            case WS::ClientImplementationType::Wayland:
+            case WS::ClientImplementationType::SHM:
+                m_impl = WS::EGLClient::BackendImpl::create<WS::EGLClient::BackendWayland>(*this);
+                break;
+            }
+        }
+        return *m_impl;
+    }
+
+private:
     std::unique_ptr<WS::EGLClient::BackendImpl> m_impl;
 };
 
@@ -87,6 +100,9 @@ public:
             m_impl = WS::EGLClient::TargetImpl::create<WS::EGLClient::TargetDmabufPool>(*this, width, height);
             break;
         case WS::ClientImplementationType::Wayland:
+        case WS::ClientImplementationType::SHM:
+            // EGL rendering on top of shared memory goes through wayland-egl;
+            // CPU rendering is done with wpe_fdo_shm_target instead.
             m_impl = WS::EGLClient::TargetImpl::create<WS::EGLClient::TargetWayland>(*this, width, height);
             break;
         }
@@ -103,6 +119,12 @@ private:
         wpe_renderer_backend_egl_target_dispatch_frame_complete(m_target);
     }
 
+    void dispatchTrimMemory(WS::TrimMemoryLevel level) override
+    {
+        if (m_impl)
+            m_impl->trimMemory(level);
+    }
+
     struct wpe_renderer_backend_egl_target* m_target { nullptr };
 };
 
@@ -124,13 +146,13 @@ struct wpe_renderer_backend_egl_interface fdo_renderer_backend_egl = {
     [](void* data) -> EGLNativeDisplayType
     {
         auto& backend = *reinterpret_cast<Backend*>(data);
-        return backend.m_impl->nativeDisplay();
+        return backend.impl().nativeDisplay();
     },
     // get_platform
     [](void* data) -> uint32_t
     {
         auto& backend = *reinterpret_cast<Backend*>(data);
-        return backend.m_impl->platform();
+        return backend.impl().platform();
     },
 };
 
@@ -170,12 +192,14 @@ struct wpe_renderer_backend_egl_target_interface fdo_renderer_backend_egl_target
     {
         auto& target = *reinterpret_cast<Target*>(data);
         target.m_impl->frameWillRender();
+        WS_TRACE_MARK("frameWillRender", target.bridgeId(), target.frameSequence());
     },
     // frame_rendered
     [](void* data)
     {
         auto& target = *reinterpret_cast<Target*>(data);
-        target.m_impl->frameRendered();
+        WS_TRACE_MARK("frameRendered", target.bridgeId(), target.frameSequence());
+        target.m_impl->frameRendered(nullptr, 0);
     },
 #if WPE_CHECK_VERSION(1,9,1)
     // deinitialize
@@ -207,3 +231,39 @@ struct wpe_renderer_backend_egl_offscreen_target_interface fdo_renderer_backend_
         return nullptr;
     },
 };
+
+extern "C" {
+
+__attribute__((visibility("default")))
+bool
+wpe_fdo_renderer_backend_egl_target_get_frame_timing(struct wpe_renderer_backend_egl_target* target, struct wpe_fdo_frame_timing* timing)
+{
+    auto* base = reinterpret_cast<struct wpe_renderer_backend_egl_target_base*>(target);
+    const auto& frameTiming = static_cast<Target*>(base->interface_data)->frameTiming();
+    if (!frameTiming.presentationTime)
+        return false;
+
+    *timing = { frameTiming.refreshInterval, frameTiming.presentationTime, frameTiming.deadline };
+    return true;
+}
+
+__attribute__((visibility("default")))
+uint32_t
+wpe_fdo_renderer_backend_egl_target_get_buffer_age(struct wpe_renderer_backend_egl_target* target)
+{
+    auto* base = reinterpret_cast<struct wpe_renderer_backend_egl_target_base*>(target);
+    auto& impl = static_cast<Target*>(base->interface_data)->m_impl;
+    return impl ? impl->bufferAge() : 0;
+}
+
+__attribute__((visibility("default")))
+void
+wpe_fdo_renderer_backend_egl_target_frame_rendered_with_damage(struct wpe_renderer_backend_egl_target* target, const struct wpe_fdo_rectangle* damage, uint32_t n_damage)
+{
+    auto* base = reinterpret_cast<struct wpe_renderer_backend_egl_target_base*>(target);
+    auto& fdoTarget = *static_cast<Target*>(base->interface_data);
+    WS_TRACE_MARK("frameRendered", fdoTarget.bridgeId(), fdoTarget.frameSequence());
+    fdoTarget.m_impl->frameRendered(damage, n_damage);
+}
+
+}
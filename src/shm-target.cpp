@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/wpe/unstable/shm-target.h"
+
+#include "../include/wpe/unstable/frame-timing.h"
+#include "linux-dmabuf/drm_fourcc.h"
+#include "ws-client.h"
+#include "ws-tracing.h"
+#include <array>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wpe/wpe-egl.h>
+
+namespace {
+
+class Target final : public WS::BaseTarget, public WS::BaseTarget::Impl {
+public:
+    Target(WS::BaseBackend& backend, int hostFD, const struct wpe_fdo_shm_target_client* client, void* data, uint32_t width, uint32_t height)
+        : WS::BaseTarget(hostFD, *this)
+        , m_client(client)
+        , m_data(data)
+    {
+        WS::BaseTarget::initialize(backend);
+
+        m_shm.width = width;
+        m_shm.height = height;
+    }
+
+    ~Target()
+    {
+        destroyPool();
+    }
+
+    void resize(uint32_t width, uint32_t height)
+    {
+        if (m_shm.width == width && m_shm.height == height)
+            return;
+
+        m_shm.width = width;
+        m_shm.height = height;
+        destroyPool();
+    }
+
+    bool beginFrame(struct wpe_fdo_shm_target_buffer& target)
+    {
+        if (!shm() || !m_shm.width || !m_shm.height)
+            return false;
+
+        // The memory is needed again, a trim waiting for the host is moot.
+        m_trimPending = false;
+
+        // The supported formats arrive along with the bridge connection.
+        waitForConnection();
+        if (!m_shm.pool && !createPool())
+            return false;
+
+        Buffer* buffer = acquireBuffer();
+        if (!buffer)
+            return false;
+
+        requestFrame();
+
+        m_current = buffer;
+        target.data = m_shm.data + buffer->offset;
+        target.width = m_shm.width;
+        target.height = m_shm.height;
+        target.stride = m_shm.stride;
+        target.format = m_shm.format;
+        target.age = buffer->age;
+        return true;
+    }
+
+    void endFrame(const struct wpe_fdo_rectangle* damage, uint32_t damageCount)
+    {
+        if (!m_current)
+            return;
+
+        wl_surface_attach(surface(), m_current->buffer, 0, 0);
+        damageBuffer(damage, damageCount);
+        wl_surface_commit(surface());
+
+        for (auto& buffer : m_buffers) {
+            if (buffer.age)
+                ++buffer.age;
+        }
+        m_current->age = 1;
+        m_current->busy = true;
+        m_current = nullptr;
+    }
+
+private:
+    // Up to three buffers are used: two suffice while the host releases them
+    // in time, and the third avoids waiting when it holds on to one.
+    static const unsigned s_maxBuffers = 3;
+
+    struct Buffer {
+        Target* target { nullptr };
+        struct wl_buffer* buffer { nullptr };
+        size_t offset { 0 };
+        bool busy { false };
+        uint32_t age { 0 };
+    };
+
+    // WS::BaseTarget::Impl
+    void dispatchFrameComplete() override
+    {
+        if (m_client->frame_complete)
+            m_client->frame_complete(m_data);
+    }
+
+    void dispatchTrimMemory(WS::TrimMemoryLevel) override
+    {
+        // The host may have wrapped the pool memory into a dma-buf or mapped
+        // it, so pages cannot be taken away from under it: the whole pool goes
+        // instead, once the host holds none of its buffers, and is created
+        // again on the next frame. All buffers live in the one pool, so there
+        // is no spare to keep at the moderate level.
+        m_trimPending = true;
+        trimIfIdle();
+    }
+
+    void bufferReleased(Buffer& buffer)
+    {
+        buffer.busy = false;
+        trimIfIdle();
+    }
+
+    void trimIfIdle()
+    {
+        if (!m_trimPending || m_current)
+            return;
+
+        for (auto& buffer : m_buffers) {
+            if (buffer.busy)
+                return;
+        }
+
+        m_trimPending = false;
+        WS_TRACE_MARK("destroyPool", bridgeId(), frameSequence());
+        destroyPool();
+    }
+
+    bool createPool()
+    {
+        // Apart from these two, wl_shm formats use the DRM fourcc codes.
+        m_shm.format = WL_SHM_FORMAT_ARGB8888;
+        uint32_t bytesPerPixel = 4;
+        switch (preferredFormat()) {
+        case DRM_FORMAT_XRGB8888:
+            m_shm.format = WL_SHM_FORMAT_XRGB8888;
+            break;
+        case DRM_FORMAT_RGB565:
+            if (supportsShmFormat(WL_SHM_FORMAT_RGB565)) {
+                m_shm.format = WL_SHM_FORMAT_RGB565;
+                bytesPerPixel = 2;
+            }
+            break;
+        default:
+            break;
+        }
+
+        // Rows are kept 4-byte aligned, as expected by pixman and GL uploads.
+        m_shm.stride = (m_shm.width * bytesPerPixel + 3) & ~3u;
+        m_shm.bufferSize = size_t(m_shm.stride) * m_shm.height;
+        m_shm.size = m_shm.bufferSize * s_maxBuffers;
+
+        // Sealing the memory against shrinking lets the host access it without
+        // guarding against SIGBUS, and import it as a dma-buf.
+        m_shm.fd = memfd_create("WPEBackend-fdo::shm-target", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (m_shm.fd == -1)
+            return false;
+
+        if (ftruncate(m_shm.fd, m_shm.size) == -1) {
+            destroyPool();
+            return false;
+        }
+        fcntl(m_shm.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+
+        void* data = mmap(nullptr, m_shm.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_shm.fd, 0);
+        if (data == MAP_FAILED) {
+            destroyPool();
+            return false;
+        }
+        m_shm.data = static_cast<uint8_t*>(data);
+
+        m_shm.pool = wl_shm_create_pool(shm(), m_shm.fd, m_shm.size);
+        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(m_shm.pool), eventQueue());
+        return true;
+    }
+
+    void destroyPool()
+    {
+        m_current = nullptr;
+        for (auto& buffer : m_buffers) {
+            g_clear_pointer(&buffer.buffer, wl_buffer_destroy);
+            buffer = { };
+        }
+
+        g_clear_pointer(&m_shm.pool, wl_shm_pool_destroy);
+        if (m_shm.data) {
+            munmap(m_shm.data, m_shm.size);
+            m_shm.data = nullptr;
+        }
+        if (m_shm.fd != -1) {
+            close(m_shm.fd);
+            m_shm.fd = -1;
+        }
+    }
+
+    Buffer* acquireBuffer()
+    {
+        while (true) {
+            // Prefer the most recently presented buffer, which needs the
+            // least repainting.
+            Buffer* candidate = nullptr;
+            for (auto& buffer : m_buffers) {
+                if (!buffer.buffer || buffer.busy)
+                    continue;
+                if (!candidate || (buffer.age && (!candidate->age || buffer.age < candidate->age)))
+                    candidate = &buffer;
+            }
+            if (candidate)
+                return candidate;
+
+            for (unsigned i = 0; i < s_maxBuffers; ++i) {
+                auto& buffer = m_buffers[i];
+                if (buffer.buffer)
+                    continue;
+
+                WS_TRACE_MARK("allocateBuffer", bridgeId(), frameSequence());
+                buffer.target = this;
+                buffer.offset = i * m_shm.bufferSize;
+                buffer.buffer = wl_shm_pool_create_buffer(m_shm.pool, buffer.offset,
+                    m_shm.width, m_shm.height, m_shm.stride, m_shm.format);
+                wl_buffer_add_listener(buffer.buffer, &s_bufferListener, &buffer);
+                return &buffer;
+            }
+
+            // All the buffers are held by the host, wait for one to be released.
+            if (wl_display_dispatch_queue(display(), eventQueue()) == -1)
+                return nullptr;
+        }
+    }
+
+    static const struct wl_buffer_listener s_bufferListener;
+
+    const struct wpe_fdo_shm_target_client* m_client;
+    void* m_data;
+
+    struct {
+        uint32_t width { 0 };
+        uint32_t height { 0 };
+        uint32_t stride { 0 };
+        uint32_t format { WL_SHM_FORMAT_ARGB8888 };
+        size_t bufferSize { 0 };
+
+        int fd { -1 };
+        size_t size { 0 };
+        uint8_t* data { nullptr };
+        struct wl_shm_pool* pool { nullptr };
+    } m_shm;
+
+    std::array<Buffer, s_maxBuffers> m_buffers;
+    Buffer* m_current { nullptr };
+    bool m_trimPending { false };
+};
+
+const struct wl_buffer_listener Target::s_bufferListener = {
+    // release
+    [](void* data, struct wl_buffer*)
+    {
+        auto& buffer = *static_cast<Buffer*>(data);
+        buffer.target->bufferReleased(buffer);
+    },
+};
+
+} // namespace
+
+extern "C" {
+
+__attribute__((visibility("default")))
+struct wpe_fdo_shm_target*
+wpe_fdo_shm_target_create(struct wpe_renderer_backend_egl* backend, int host_fd, const struct wpe_fdo_shm_target_client* client, void* data, uint32_t width, uint32_t height)
+{
+    auto* base = reinterpret_cast<struct wpe_renderer_backend_egl_base*>(backend);
+    auto* target = new Target(*static_cast<WS::BaseBackend*>(base->interface_data), host_fd, client, data, width, height);
+    if (!target->shm()) {
+        g_warning("wpe_fdo_shm_target_create(): the host does not support shared memory buffers");
+        delete target;
+        return nullptr;
+    }
+
+    return reinterpret_cast<struct wpe_fdo_shm_target*>(target);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_fdo_shm_target_destroy(struct wpe_fdo_shm_target* target)
+{
+    delete reinterpret_cast<Target*>(target);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_fdo_shm_target_resize(struct wpe_fdo_shm_target* target, uint32_t width, uint32_t height)
+{
+    reinterpret_cast<Target*>(target)->resize(width, height);
+}
+
+__attribute__((visibility("default")))
+bool
+wpe_fdo_shm_target_begin_frame(struct wpe_fdo_shm_target* target, struct wpe_fdo_shm_target_buffer* buffer)
+{
+    return reinterpret_cast<Target*>(target)->beginFrame(*buffer);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_fdo_shm_target_end_frame(struct wpe_fdo_shm_target* target, const struct wpe_fdo_rectangle* damage, uint32_t n_damage)
+{
+    reinterpret_cast<Target*>(target)->endFrame(damage, n_damage);
+}
+
+__attribute__((visibility("default")))
+bool
+wpe_fdo_shm_target_get_frame_timing(struct wpe_fdo_shm_target* target, struct wpe_fdo_frame_timing* timing)
+{
+    const auto& frameTiming = reinterpret_cast<Target*>(target)->frameTiming();
+    if (!frameTiming.presentationTime)
+        return false;
+
+    *timing = { frameTiming.refreshInterval, frameTiming.presentationTime, frameTiming.deadline };
+    return true;
+}
+
+}
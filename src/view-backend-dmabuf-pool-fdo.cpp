@@ -26,6 +26,7 @@
 #include "dmabuf-pool-entry-private.h"
 #include "view-backend-private.h"
 #include "wpe/unstable/view-backend-dmabuf-pool-fdo.h"
+#include "wpe/view-backend-exportable.h"
 
 class ClientBundleDmabufPool final : public ClientBundle {
 public:
@@ -42,22 +43,42 @@ public:
     void exportBuffer(struct wl_resource* bufferResource, struct wl_shm_buffer* shmBuffer) override { }
     void exportEGLStreamProducer(struct wl_resource* bufferResource) override { }
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t width, uint32_t height, uint32_t format) override
     {
+        if (client->create_entry_with_format)
+            return client->create_entry_with_format(data, width, height, format);
         return client->create_entry(data);
     }
 
     void commitDmabufPoolEntry(struct wpe_dmabuf_pool_entry* entry) override
     {
+        clearAcquireFence(entry);
+        entry->acquireFence = viewBackend->takeAcquireFence();
+        viewBackend->fillViewport(&entry->viewport);
+        viewBackend->fillOpaqueRegion(entry->opaqueRegion);
+
+        viewBackend->statistics().bufferExported(entry->bufferResource);
         client->commit_entry(data, entry);
     }
 
-    void releaseDmabufPoolEntry(struct wpe_dmabuf_pool_entry* entry)
+    void releaseDmabufPoolEntry(struct wpe_dmabuf_pool_entry* entry, int releaseFence)
     {
-        viewBackend->releaseBuffer(entry->bufferResource);
+        clearAcquireFence(entry);
+
+        viewBackend->statistics().bufferReleased(entry->bufferResource);
+        viewBackend->releaseBuffer(entry->bufferResource, releaseFence);
     }
 
     const struct wpe_view_backend_dmabuf_pool_fdo_client* client;
+
+private:
+    static void clearAcquireFence(struct wpe_dmabuf_pool_entry* entry)
+    {
+        if (entry->acquireFence != -1) {
+            close(entry->acquireFence);
+            entry->acquireFence = -1;
+        }
+    }
 };
 
 extern "C" {
@@ -98,7 +119,63 @@ __attribute__((visibility("default")))
 void
 wpe_view_backend_dmabuf_pool_fdo_dispatch_release_entry(struct wpe_view_backend_dmabuf_pool_fdo* exportable, struct wpe_dmabuf_pool_entry* entry)
 {
-    reinterpret_cast<ClientBundleDmabufPool*>(exportable->clientBundle.get())->releaseDmabufPoolEntry(entry);
+    reinterpret_cast<ClientBundleDmabufPool*>(exportable->clientBundle.get())->releaseDmabufPoolEntry(entry, -1);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_dispatch_release_entry_with_fence(struct wpe_view_backend_dmabuf_pool_fdo* exportable, struct wpe_dmabuf_pool_entry* entry, int release_fence)
+{
+    reinterpret_cast<ClientBundleDmabufPool*>(exportable->clientBundle.get())->releaseDmabufPoolEntry(entry, release_fence);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_set_presentation_mode(struct wpe_view_backend_dmabuf_pool_fdo* exportable, uint32_t mode)
+{
+    exportable->clientBundle->presentationMode = static_cast<enum wpe_view_backend_exportable_fdo_presentation_mode>(mode);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_set_render_scale_hint(struct wpe_view_backend_dmabuf_pool_fdo* exportable, float scale)
+{
+    exportable->clientBundle->viewBackend->setRenderScaleHint(scale);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_set_visible(struct wpe_view_backend_dmabuf_pool_fdo* exportable, bool visible)
+{
+    exportable->clientBundle->viewBackend->setVisible(visible);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_set_hidden_frame_interval(struct wpe_view_backend_dmabuf_pool_fdo* exportable, uint32_t interval)
+{
+    exportable->clientBundle->viewBackend->setHiddenFrameInterval(interval);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_set_output_properties(struct wpe_view_backend_dmabuf_pool_fdo* exportable, int32_t scale, int32_t transform)
+{
+    exportable->clientBundle->viewBackend->setOutputProperties(scale, transform);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_dispatch_frame_timing(struct wpe_view_backend_dmabuf_pool_fdo* exportable, uint64_t refresh_interval, uint64_t presentation_time, uint64_t deadline)
+{
+    exportable->clientBundle->viewBackend->dispatchFrameTiming(refresh_interval, presentation_time, deadline);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_dmabuf_pool_fdo_get_statistics(struct wpe_view_backend_dmabuf_pool_fdo* exportable, struct wpe_view_backend_exportable_fdo_statistics* statistics)
+{
+    exportable->clientBundle->viewBackend->statistics().fill(statistics);
 }
 
 } // extern "C"
@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include "../include/wpe/viewport.h"
+#include <vector>
 #include <wayland-server.h>
 
 typedef void *EGLImageKHR;
@@ -34,6 +36,10 @@ struct wpe_fdo_egl_exported_image {
     uint32_t width { 0 };
     uint32_t height { 0 };
     bool exported { false };
+    int acquireFence { -1 };
+    struct wpe_fdo_viewport viewport { };
+    std::vector<struct wpe_fdo_rectangle> opaqueRegion;
     struct wl_resource* bufferResource { nullptr };
     struct wl_listener bufferDestroyListener;
+    struct wl_list link;
 };
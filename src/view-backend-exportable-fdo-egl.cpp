@@ -33,6 +33,7 @@
 #include <epoxy/egl.h>
 #include <cassert>
 #include <list>
+#include <unistd.h>
 
 namespace {
 
@@ -85,12 +86,15 @@ public:
         wl_resource_add_destroy_listener(buffer, &resource->destroyListener);
         wl_list_insert(&bufferResources, &resource->link);
 
+        viewBackend->statistics().bufferExported(resource->resource);
         client->export_egl_image(data, image);
     }
 
     void exportBuffer(const struct linux_dmabuf_buffer *dmabuf_buffer) override
     {
-        EGLImageKHR image = WS::instanceImpl<WS::ImplEGL>().createImage(dmabuf_buffer);
+        // Buffers are found again from the image the embedder releases, so
+        // each export needs its own instead of one from the import cache.
+        EGLImageKHR image = WS::instanceImpl<WS::ImplEGL>().createImage(dmabuf_buffer, false);
         if (!image)
             return;
 
@@ -102,6 +106,7 @@ public:
         wl_resource_add_destroy_listener(dmabuf_buffer->buffer_resource, &resource->destroyListener);
         wl_list_insert(&bufferResources, &resource->link);
 
+        viewBackend->statistics().bufferExported(resource->resource);
         client->export_egl_image(data, image);
     }
 
@@ -110,6 +115,12 @@ public:
         auto* buffer = new struct wpe_fdo_shm_exported_buffer;
         buffer->resource = bufferResource;
         buffer->shm_buffer = shmBuffer;
+        buffer->size = size_t(wl_shm_buffer_get_stride(shmBuffer)) * wl_shm_buffer_get_height(shmBuffer);
+        viewBackend->fillViewport(&buffer->viewport);
+        viewBackend->fillOpaqueRegion(buffer->opaqueRegion);
+        viewBackend->fillShmDmabuf(bufferResource, &buffer->dmabuf);
+        viewBackend->fillShmData(buffer);
+        viewBackend->statistics().bufferExported(bufferResource, buffer->size);
         client->export_shm_buffer(data, buffer);
     }
 
@@ -118,7 +129,7 @@ public:
         assert(!"should not be reached");
     }
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t, uint32_t, uint32_t) override
     {
         assert(!"should not be reached");
         return nullptr;
@@ -143,6 +154,7 @@ public:
         WS::instanceImpl<WS::ImplEGL>().destroyImage(image);
 
         if (matchingResource) {
+            viewBackend->statistics().bufferReleased(matchingResource->resource);
             viewBackend->releaseBuffer(matchingResource->resource);
 
             wl_list_remove(&matchingResource->link);
@@ -172,9 +184,19 @@ public:
         : ClientBundle(data, viewBackend, initialWidth, initialHeight)
         , client(_client)
     {
+        wl_list_init(&images);
     }
 
-    virtual ~ClientBundleEGL() = default;
+    virtual ~ClientBundleEGL()
+    {
+        // Images outlive the bundle until their buffers are destroyed.
+        struct wpe_fdo_egl_exported_image* image;
+        struct wpe_fdo_egl_exported_image* next;
+        wl_list_for_each_safe(image, next, &images, link) {
+            wl_list_remove(&image->link);
+            wl_list_init(&image->link);
+        }
+    }
 
     void exportBuffer(struct wl_resource* bufferResource) override
     {
@@ -194,6 +216,7 @@ public:
         wl_list_init(&image->bufferDestroyListener.link);
         image->bufferDestroyListener.notify = bufferDestroyListenerCallback;
         wl_resource_add_destroy_listener(bufferResource, &image->bufferDestroyListener);
+        wl_list_insert(&images, &image->link);
 
         exportImage(image);
     }
@@ -217,6 +240,7 @@ public:
         wl_list_init(&image->bufferDestroyListener.link);
         image->bufferDestroyListener.notify = bufferDestroyListenerCallback;
         wl_resource_add_destroy_listener(dmabufBuffer->buffer_resource, &image->bufferDestroyListener);
+        wl_list_insert(&images, &image->link);
 
         exportImage(image);
     }
@@ -226,6 +250,12 @@ public:
         auto* buffer = new struct wpe_fdo_shm_exported_buffer;
         buffer->resource = bufferResource;
         buffer->shm_buffer = shmBuffer;
+        buffer->size = size_t(wl_shm_buffer_get_stride(shmBuffer)) * wl_shm_buffer_get_height(shmBuffer);
+        viewBackend->fillViewport(&buffer->viewport);
+        viewBackend->fillOpaqueRegion(buffer->opaqueRegion);
+        viewBackend->fillShmDmabuf(bufferResource, &buffer->dmabuf);
+        viewBackend->fillShmData(buffer);
+        viewBackend->statistics().bufferExported(bufferResource, buffer->size);
         client->export_shm_buffer(data, buffer);
     }
 
@@ -234,7 +264,7 @@ public:
         assert(!"should not be reached");
     }
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t, uint32_t, uint32_t) override
     {
         assert(!"should not be reached");
         return nullptr;
@@ -245,20 +275,48 @@ public:
         assert(!"should not be reached");
     }
 
-    void releaseImage(struct wpe_fdo_egl_exported_image* image)
+    void releaseImage(struct wpe_fdo_egl_exported_image* image, int releaseFence)
     {
-        if (!image)
+        if (!image) {
+            if (releaseFence != -1)
+                close(releaseFence);
             return;
+        }
+
+        viewBackend->statistics().bufferReleased(image->bufferResource);
+        clearAcquireFence(image);
         if (image->exported) {
             image->exported = false;
-            if (image->bufferResource)
-                viewBackend->releaseBuffer(image->bufferResource);
+            if (image->bufferResource) {
+                viewBackend->releaseBuffer(image->bufferResource, releaseFence);
+                return;
+            }
         } else
             deleteImage(image);
+
+        if (releaseFence != -1)
+            close(releaseFence);
+    }
+
+    void trimMemory(WS::TrimMemoryLevel) override
+    {
+        // Images not currently exported are recreated when their buffers
+        // get attached again. Those without a buffer are still held by the
+        // embedder, and get destroyed once released.
+        struct wpe_fdo_egl_exported_image* image;
+        struct wpe_fdo_egl_exported_image* next;
+        wl_list_for_each_safe(image, next, &images, link) {
+            if (image->exported || !image->bufferResource)
+                continue;
+
+            wl_list_remove(&image->bufferDestroyListener.link);
+            deleteImage(image);
+        }
     }
 
     void releaseShmBuffer(struct wpe_fdo_shm_exported_buffer* buffer)
     {
+        viewBackend->statistics().bufferReleased(buffer->resource, buffer->size);
         if (buffer->resource)
             viewBackend->releaseBuffer(buffer->resource);
         delete buffer;
@@ -267,6 +325,9 @@ public:
     const struct wpe_view_backend_exportable_fdo_egl_client* client;
 
 private:
+    // All the images created by the bundle, exported or not.
+    struct wl_list images;
+
     struct wpe_fdo_egl_exported_image* findImage(struct wl_resource* bufferResource)
     {
         if (bufferResource) {
@@ -281,13 +342,28 @@ private:
 
     void exportImage(struct wpe_fdo_egl_exported_image* image)
     {
+        clearAcquireFence(image);
+        image->acquireFence = viewBackend->takeAcquireFence();
+        viewBackend->fillViewport(&image->viewport);
+        viewBackend->fillOpaqueRegion(image->opaqueRegion);
         image->exported = true;
+        viewBackend->statistics().bufferExported(image->bufferResource);
         client->export_fdo_egl_image(data, image);
     }
 
+    static void clearAcquireFence(struct wpe_fdo_egl_exported_image* image)
+    {
+        if (image->acquireFence != -1) {
+            close(image->acquireFence);
+            image->acquireFence = -1;
+        }
+    }
+
     static void deleteImage(struct wpe_fdo_egl_exported_image* image)
     {
         assert(image->eglImage);
+        clearAcquireFence(image);
+        wl_list_remove(&image->link);
         WS::instanceImpl<WS::ImplEGL>().destroyImage(image->eglImage);
         delete image;
     }
@@ -336,7 +412,14 @@ __attribute__((visibility("default")))
 void
 wpe_view_backend_exportable_fdo_egl_dispatch_release_exported_image(struct wpe_view_backend_exportable_fdo* exportable, struct wpe_fdo_egl_exported_image* image)
 {
-    static_cast<ClientBundleEGL*>(exportable->clientBundle.get())->releaseImage(image);
+    static_cast<ClientBundleEGL*>(exportable->clientBundle.get())->releaseImage(image, -1);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_egl_dispatch_release_exported_image_with_fence(struct wpe_view_backend_exportable_fdo* exportable, struct wpe_fdo_egl_exported_image* image, int release_fence)
+{
+    static_cast<ClientBundleEGL*>(exportable->clientBundle.get())->releaseImage(image, release_fence);
 }
 
 __attribute__((visibility("default")))
@@ -71,7 +71,7 @@ public:
         client->export_eglstream_producer_resource(data, bufferResource);
     }
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t, uint32_t, uint32_t) override
     {
         assert(!"should not be reached");
         return nullptr;
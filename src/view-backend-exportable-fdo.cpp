@@ -30,18 +30,44 @@
 #include "ws.h"
 #include <cassert>
 #include <cstring>
+#include <unistd.h>
 
 namespace {
 
+void fillDmabufResource(struct wpe_view_backend_exportable_fdo_dmabuf_resource& dmabuf_resource, const struct linux_dmabuf_buffer* dmabuf_buffer)
+{
+    auto* attributes = &dmabuf_buffer->attributes;
+
+    std::memset(&dmabuf_resource, 0, sizeof(struct wpe_view_backend_exportable_fdo_dmabuf_resource));
+    dmabuf_resource.buffer_resource = dmabuf_buffer->buffer_resource;
+    dmabuf_resource.acquire_fence = -1;
+    dmabuf_resource.width = attributes->width;
+    dmabuf_resource.height = attributes->height;
+    dmabuf_resource.format = attributes->format;
+
+    if (attributes->n_planes >= 0)
+        dmabuf_resource.n_planes = attributes->n_planes;
+    for (uint8_t i = 0; i < dmabuf_resource.n_planes; ++i) {
+        dmabuf_resource.fds[i] = attributes->fd[i];
+        dmabuf_resource.strides[i] = attributes->stride[i];
+        dmabuf_resource.offsets[i] = attributes->offset[i];
+        dmabuf_resource.modifiers[i] = attributes->modifier[i];
+    }
+}
+
 class ClientBundleBuffer final : public ClientBundle {
 public:
     struct BufferResource {
         struct wl_resource* resource;
+        int acquireFence { -1 };
+        struct wpe_fdo_viewport viewport;
+        std::vector<struct wpe_fdo_rectangle> opaqueRegion;
 
         struct wl_list link;
         struct wl_listener destroyListener;
 
         static void destroyNotify(struct wl_listener*, void*);
+        static void destroy(BufferResource*);
     };
 
     ClientBundleBuffer(const struct wpe_view_backend_exportable_fdo_client* _client, void* data, ViewBackend* viewBackend,
@@ -61,7 +87,7 @@ public:
 
             wl_list_remove(&resource->link);
             wl_list_remove(&resource->destroyListener.link);
-            delete resource;
+            BufferResource::destroy(resource);
         }
         wl_list_init(&bufferResources);
     }
@@ -70,41 +96,34 @@ public:
     {
         auto* resource = new BufferResource;
         resource->resource = buffer;
+        viewBackend->fillViewport(&resource->viewport);
+        viewBackend->fillOpaqueRegion(resource->opaqueRegion);
         resource->destroyListener.notify = BufferResource::destroyNotify;
 
         wl_resource_add_destroy_listener(buffer, &resource->destroyListener);
         wl_list_insert(&bufferResources, &resource->link);
 
+        viewBackend->statistics().bufferExported(buffer);
         client->export_buffer_resource(data, buffer);
     }
 
     void exportBuffer(const struct linux_dmabuf_buffer *dmabuf_buffer) override
     {
-        auto* attributes = &dmabuf_buffer->attributes;
-
         struct wpe_view_backend_exportable_fdo_dmabuf_resource dmabuf_resource;
-        std::memset(&dmabuf_resource, 0, sizeof(struct wpe_view_backend_exportable_fdo_dmabuf_resource));
-        dmabuf_resource.buffer_resource = dmabuf_buffer->buffer_resource;
-        dmabuf_resource.width = attributes->width;
-        dmabuf_resource.height = attributes->height;
-        dmabuf_resource.format = attributes->format;
-
-        if (attributes->n_planes >= 0)
-            dmabuf_resource.n_planes = attributes->n_planes;
-        for (uint8_t i = 0; i < dmabuf_resource.n_planes; ++i) {
-            dmabuf_resource.fds[i] = attributes->fd[i];
-            dmabuf_resource.strides[i] = attributes->stride[i];
-            dmabuf_resource.offsets[i] = attributes->offset[i];
-            dmabuf_resource.modifiers[i] = attributes->modifier[i];
-        }
+        fillDmabufResource(dmabuf_resource, dmabuf_buffer);
+        dmabuf_resource.acquire_fence = viewBackend->takeAcquireFence();
 
         auto* resource = new BufferResource;
         resource->resource = dmabuf_buffer->buffer_resource;
+        resource->acquireFence = dmabuf_resource.acquire_fence;
+        viewBackend->fillViewport(&resource->viewport);
+        viewBackend->fillOpaqueRegion(resource->opaqueRegion);
         resource->destroyListener.notify = BufferResource::destroyNotify;
 
         wl_resource_add_destroy_listener(dmabuf_buffer->buffer_resource, &resource->destroyListener);
         wl_list_insert(&bufferResources, &resource->link);
 
+        viewBackend->statistics().bufferExported(dmabuf_buffer->buffer_resource);
         client->export_dmabuf_resource(data, &dmabuf_resource);
     }
 
@@ -113,6 +132,12 @@ public:
         auto* buffer = new struct wpe_fdo_shm_exported_buffer;
         buffer->resource = bufferResource;
         buffer->shm_buffer = shmBuffer;
+        buffer->size = size_t(wl_shm_buffer_get_stride(shmBuffer)) * wl_shm_buffer_get_height(shmBuffer);
+        viewBackend->fillViewport(&buffer->viewport);
+        viewBackend->fillOpaqueRegion(buffer->opaqueRegion);
+        viewBackend->fillShmDmabuf(bufferResource, &buffer->dmabuf);
+        viewBackend->fillShmData(buffer);
+        viewBackend->statistics().bufferExported(bufferResource, buffer->size);
         client->export_shm_buffer(data, buffer);
     }
 
@@ -121,7 +146,7 @@ public:
         assert(!"should not be reached");
     }
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t, uint32_t, uint32_t) override
     {
         assert(!"should not be reached");
         return nullptr;
@@ -132,29 +157,68 @@ public:
         assert(!"should not be reached");
     }
 
-    void releaseBuffer(struct wl_resource* buffer)
+    void layersUpdated(const std::vector<WS::Layer>& layers) override
+    {
+        // Reserved upfront, layers point into the dma-buf resource vector.
+        dmabufLayerResources.clear();
+        dmabufLayerResources.reserve(layers.size());
+        exportedLayers.clear();
+        exportedLayers.reserve(layers.size());
+
+        for (auto& layer : layers) {
+            struct wpe_view_backend_exportable_fdo_layer exportedLayer;
+            std::memset(&exportedLayer, 0, sizeof(struct wpe_view_backend_exportable_fdo_layer));
+            exportedLayer.buffer_resource = layer.bufferResource;
+            exportedLayer.x = layer.x;
+            exportedLayer.y = layer.y;
+            exportedLayer.z_order = layer.zOrder;
+            exportedLayer.damage.x = layer.damage.x;
+            exportedLayer.damage.y = layer.damage.y;
+            exportedLayer.damage.width = layer.damage.width;
+            exportedLayer.damage.height = layer.damage.height;
+
+            if (layer.dmabufBuffer) {
+                dmabufLayerResources.emplace_back();
+                fillDmabufResource(dmabufLayerResources.back(), layer.dmabufBuffer);
+                exportedLayer.dmabuf_resource = &dmabufLayerResources.back();
+            }
+            exportedLayers.push_back(exportedLayer);
+        }
+
+        if (client->layers_updated)
+            client->layers_updated(data);
+    }
+
+    BufferResource* findBufferResource(struct wl_resource* buffer)
     {
-        BufferResource* matchingResource = nullptr;
         BufferResource* resource;
         wl_list_for_each(resource, &bufferResources, link) {
-            if (resource->resource == buffer) {
-                matchingResource = resource;
-                break;
-            }
+            if (resource->resource == buffer)
+                return resource;
         }
+        return nullptr;
+    }
 
-        if (!matchingResource)
+    void releaseBuffer(struct wl_resource* buffer, int releaseFence)
+    {
+        BufferResource* matchingResource = findBufferResource(buffer);
+        if (!matchingResource) {
+            if (releaseFence != -1)
+                close(releaseFence);
             return;
+        }
 
-        viewBackend->releaseBuffer(buffer);
+        viewBackend->statistics().bufferReleased(buffer);
+        viewBackend->releaseBuffer(buffer, releaseFence);
 
         wl_list_remove(&matchingResource->link);
         wl_list_remove(&matchingResource->destroyListener.link);
-        delete matchingResource;
+        BufferResource::destroy(matchingResource);
     }
 
     void releaseBuffer(struct wpe_fdo_shm_exported_buffer* buffer)
     {
+        viewBackend->statistics().bufferReleased(buffer->resource, buffer->size);
         if (buffer->resource)
             viewBackend->releaseBuffer(buffer->resource);
         delete buffer;
@@ -163,6 +227,9 @@ public:
     const struct wpe_view_backend_exportable_fdo_client* client;
 
     struct wl_list bufferResources;
+
+    std::vector<struct wpe_view_backend_exportable_fdo_layer> exportedLayers;
+    std::vector<struct wpe_view_backend_exportable_fdo_dmabuf_resource> dmabufLayerResources;
 };
 
 void ClientBundleBuffer::BufferResource::destroyNotify(struct wl_listener* listener, void*)
@@ -171,6 +238,13 @@ void ClientBundleBuffer::BufferResource::destroyNotify(struct wl_listener* liste
     resource = wl_container_of(listener, resource, destroyListener);
 
     wl_list_remove(&resource->link);
+    destroy(resource);
+}
+
+void ClientBundleBuffer::BufferResource::destroy(BufferResource* resource)
+{
+    if (resource->acquireFence != -1)
+        close(resource->acquireFence);
     delete resource;
 }
 
@@ -214,7 +288,14 @@ __attribute__((visibility("default")))
 void
 wpe_view_backend_exportable_fdo_dispatch_release_buffer(struct wpe_view_backend_exportable_fdo* exportable, struct wl_resource* buffer)
 {
-    static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->releaseBuffer(buffer);
+    static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->releaseBuffer(buffer, -1);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_dispatch_release_buffer_with_fence(struct wpe_view_backend_exportable_fdo* exportable, struct wl_resource* buffer, int release_fence)
+{
+    static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->releaseBuffer(buffer, release_fence);
 }
 
 __attribute__((visibility("default")))
@@ -224,4 +305,88 @@ wpe_view_backend_exportable_fdo_dispatch_release_shm_exported_buffer(struct wpe_
     static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->releaseBuffer(buffer);
 }
 
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_set_presentation_mode(struct wpe_view_backend_exportable_fdo* exportable, enum wpe_view_backend_exportable_fdo_presentation_mode mode)
+{
+    exportable->clientBundle->presentationMode = mode;
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_get_statistics(struct wpe_view_backend_exportable_fdo* exportable, struct wpe_view_backend_exportable_fdo_statistics* statistics)
+{
+    exportable->clientBundle->viewBackend->statistics().fill(statistics);
+}
+
+__attribute__((visibility("default")))
+bool
+wpe_view_backend_exportable_fdo_get_buffer_viewport(struct wpe_view_backend_exportable_fdo* exportable, struct wl_resource* buffer, struct wpe_fdo_viewport* viewport)
+{
+    auto* resource = static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->findBufferResource(buffer);
+    if (!resource)
+        return false;
+
+    *viewport = resource->viewport;
+    return true;
+}
+
+__attribute__((visibility("default")))
+const struct wpe_fdo_rectangle*
+wpe_view_backend_exportable_fdo_get_buffer_opaque_region(struct wpe_view_backend_exportable_fdo* exportable, struct wl_resource* buffer, uint32_t* n_rects)
+{
+    auto* resource = static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->findBufferResource(buffer);
+    if (!resource || resource->opaqueRegion.empty()) {
+        *n_rects = 0;
+        return nullptr;
+    }
+
+    *n_rects = resource->opaqueRegion.size();
+    return resource->opaqueRegion.data();
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_set_render_scale_hint(struct wpe_view_backend_exportable_fdo* exportable, float scale)
+{
+    exportable->clientBundle->viewBackend->setRenderScaleHint(scale);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_set_visible(struct wpe_view_backend_exportable_fdo* exportable, bool visible)
+{
+    exportable->clientBundle->viewBackend->setVisible(visible);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_set_hidden_frame_interval(struct wpe_view_backend_exportable_fdo* exportable, uint32_t interval)
+{
+    exportable->clientBundle->viewBackend->setHiddenFrameInterval(interval);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_set_output_properties(struct wpe_view_backend_exportable_fdo* exportable, int32_t scale, int32_t transform)
+{
+    exportable->clientBundle->viewBackend->setOutputProperties(scale, transform);
+}
+
+__attribute__((visibility("default")))
+void
+wpe_view_backend_exportable_fdo_dispatch_frame_timing(struct wpe_view_backend_exportable_fdo* exportable, uint64_t refresh_interval, uint64_t presentation_time, uint64_t deadline)
+{
+    exportable->clientBundle->viewBackend->dispatchFrameTiming(refresh_interval, presentation_time, deadline);
+}
+
+__attribute__((visibility("default")))
+const struct wpe_view_backend_exportable_fdo_layer*
+wpe_view_backend_exportable_fdo_get_layers(struct wpe_view_backend_exportable_fdo* exportable, uint32_t* n_layers)
+{
+    auto& layers = static_cast<ClientBundleBuffer*>(exportable->clientBundle.get())->exportedLayers;
+    *n_layers = layers.size();
+    return layers.empty() ? nullptr : layers.data();
+}
+
 }
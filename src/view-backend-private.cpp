@@ -23,9 +23,12 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "exported-buffer-shm-private.h"
 #include "ipc-messages.h"
 #include "view-backend-private.h"
+#include "ws-shm.h"
 #include <cassert>
+#include <cmath>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <algorithm>
@@ -35,6 +38,10 @@ ViewBackend::ViewBackend(ClientBundle* clientBundle, struct wpe_view_backend* ba
     , m_backend(backend)
 {
     m_clientBundle->viewBackend = this;
+    wl_list_init(&m_bufferReleases);
+
+    m_mailbox.destroyListener.viewBackend = this;
+    m_mailbox.destroyListener.listener.notify = mailboxBufferDestroyed;
 }
 
 ViewBackend::~ViewBackend()
@@ -42,6 +49,19 @@ ViewBackend::~ViewBackend()
     while (!m_bridgeIds.empty())
         unregisterSurface(m_bridgeIds.front());
 
+    if (m_visibility.frameSource) {
+        g_source_destroy(m_visibility.frameSource);
+        g_source_unref(m_visibility.frameSource);
+    }
+
+    dropMailboxExport(true);
+    discardCommittedSync();
+
+    struct wl_resource* release;
+    struct wl_resource* tmp;
+    wl_resource_for_each_safe(release, tmp, &m_bufferReleases)
+        WS::sendBufferRelease(release, -1);
+
     if (m_clientFd != -1)
         close(m_clientFd);
 }
@@ -74,44 +94,411 @@ int ViewBackend::clientFd()
 
 void ViewBackend::exportBufferResource(struct wl_resource* bufferResource)
 {
-    m_clientBundle->exportBuffer(bufferResource);
+    Export bufferExport;
+    bufferExport.type = Export::Type::BufferResource;
+    bufferExport.bufferResource = bufferResource;
+    submitExport(bufferExport);
 }
 
 void ViewBackend::exportLinuxDmabuf(const struct linux_dmabuf_buffer *dmabuf_buffer)
 {
-    m_clientBundle->exportBuffer(dmabuf_buffer);
+    Export bufferExport;
+    bufferExport.type = Export::Type::LinuxDmabuf;
+    bufferExport.bufferResource = dmabuf_buffer->buffer_resource;
+    bufferExport.dmabufBuffer = dmabuf_buffer;
+    submitExport(bufferExport);
 }
 
 void ViewBackend::exportShmBuffer(struct wl_resource* bufferResource, struct wl_shm_buffer* shmBuffer)
 {
-    m_clientBundle->exportBuffer(bufferResource, shmBuffer);
+    Export bufferExport;
+    bufferExport.type = Export::Type::ShmBuffer;
+    bufferExport.bufferResource = bufferResource;
+    bufferExport.shmBuffer = shmBuffer;
+    submitExport(bufferExport);
 }
 
 void ViewBackend::exportEGLStreamProducer(struct wl_resource* bufferResource)
 {
+    discardCommittedSync();
     m_clientBundle->exportEGLStreamProducer(bufferResource);
 }
 
-struct wpe_dmabuf_pool_entry* ViewBackend::createDmabufPoolEntry()
+struct wpe_dmabuf_pool_entry* ViewBackend::createDmabufPoolEntry(uint32_t width, uint32_t height, uint32_t format)
 {
-    return m_clientBundle->createDmabufPoolEntry();
+    return m_clientBundle->createDmabufPoolEntry(width, height, format);
 }
 
 void ViewBackend::commitDmabufPoolEntry(struct wpe_dmabuf_pool_entry* entry)
 {
-    m_clientBundle->commitDmabufPoolEntry(entry);
+    Export bufferExport;
+    bufferExport.type = Export::Type::DmabufPoolEntry;
+    bufferExport.bufferResource = entry->bufferResource;
+    bufferExport.entry = entry;
+    submitExport(bufferExport);
+}
+
+void ViewBackend::surfaceCommitted(struct wl_resource* buffer, WS::BufferSync&& sync, const WS::BufferState& state)
+{
+    m_statistics.frameCommitted(buffer);
+
+    // State from a previous commit which did not export any buffer.
+    discardCommittedSync();
+
+    m_committedSync = sync;
+    sync = { };
+    m_committedState = state;
+
+    // In mailbox mode the client is not paced by the embedder: frame callbacks
+    // are sent as soon as a buffer is committed, unless the view is hidden.
+    if (m_clientBundle->presentationMode == WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_MAILBOX && m_visibility.visible && !m_bridgeIds.empty()) {
+        if (WS::Instance::singleton().dispatchFrameCallbacks(m_bridgeIds.back()))
+            m_statistics.frameCallbacksDispatched();
+    }
+}
+
+void ViewBackend::layersChanged(WS::Surface& surface)
+{
+    if (m_bridgeIds.empty() || surface.bridgeId != m_bridgeIds.back())
+        return;
+
+    std::vector<WS::Layer> layers;
+    WS::collectLayers(surface, layers);
+    if (layers.empty() && !m_hasLayers)
+        return;
+
+    m_hasLayers = !layers.empty();
+    m_clientBundle->layersUpdated(layers);
+}
+
+void ViewBackend::submitExport(const Export& bufferExport)
+{
+    // Hidden views hold on to the newest buffer until shown again, as if the
+    // embedder was busy in mailbox mode.
+    if (m_clientBundle->presentationMode == WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_MAILBOX || !m_visibility.visible) {
+        if (m_mailbox.busy || !m_visibility.visible) {
+            // Replace the buffer waiting for the embedder, handing the superseded
+            // one back to the client right away.
+            dropMailboxExport(true);
+
+            m_mailbox.hasPending = true;
+            m_mailbox.pending = bufferExport;
+            m_mailbox.pendingSync = m_committedSync;
+            m_committedSync = { };
+            m_mailbox.pendingState = m_committedState;
+            wl_resource_add_destroy_listener(bufferExport.bufferResource, &m_mailbox.destroyListener.listener);
+            return;
+        }
+
+        m_mailbox.busy = true;
+    }
+
+    performExport(bufferExport);
+}
+
+void ViewBackend::performExport(const Export& bufferExport)
+{
+    trackBufferRelease(bufferExport.bufferResource);
+
+    switch (bufferExport.type) {
+    case Export::Type::BufferResource:
+        m_clientBundle->exportBuffer(bufferExport.bufferResource);
+        break;
+    case Export::Type::LinuxDmabuf:
+        m_clientBundle->exportBuffer(bufferExport.dmabufBuffer);
+        break;
+    case Export::Type::ShmBuffer:
+        m_clientBundle->exportBuffer(bufferExport.bufferResource, bufferExport.shmBuffer);
+        break;
+    case Export::Type::DmabufPoolEntry:
+        m_clientBundle->commitDmabufPoolEntry(bufferExport.entry);
+        break;
+    }
+
+    discardCommittedSync();
+}
+
+void ViewBackend::dropMailboxExport(bool releaseBuffer)
+{
+    if (!m_mailbox.hasPending)
+        return;
+
+    m_mailbox.hasPending = false;
+    wl_list_remove(&m_mailbox.destroyListener.listener.link);
+
+    if (m_mailbox.pendingSync.acquireFence != -1)
+        close(m_mailbox.pendingSync.acquireFence);
+    if (m_mailbox.pendingSync.release)
+        WS::sendBufferRelease(m_mailbox.pendingSync.release, -1);
+    m_mailbox.pendingSync = { };
+
+    if (releaseBuffer) {
+        wl_buffer_send_release(m_mailbox.pending.bufferResource);
+        wl_client_flush(wl_resource_get_client(m_mailbox.pending.bufferResource));
+    }
+}
+
+void ViewBackend::performMailboxExport()
+{
+    Export bufferExport = m_mailbox.pending;
+    WS::BufferSync sync = m_mailbox.pendingSync;
+    m_mailbox.pendingSync = { };
+    dropMailboxExport(false);
+
+    discardCommittedSync();
+    m_committedSync = sync;
+    m_committedState = m_mailbox.pendingState;
+    performExport(bufferExport);
+}
+
+void ViewBackend::mailboxBufferDestroyed(struct wl_listener* listener, void*)
+{
+    auto& viewBackend = *reinterpret_cast<MailboxDestroyListener*>(listener)->viewBackend;
+    viewBackend.dropMailboxExport(false);
+}
+
+int ViewBackend::takeAcquireFence()
+{
+    int fence = m_committedSync.acquireFence;
+    m_committedSync.acquireFence = -1;
+    return fence;
+}
+
+void ViewBackend::fillViewport(struct wpe_fdo_viewport* viewport) const
+{
+    viewport->buffer_scale = m_committedState.bufferScale;
+    viewport->buffer_transform = m_committedState.bufferTransform;
+
+    const WS::Viewport& state = m_committedState.viewport;
+    viewport->has_source = state.hasSource;
+    viewport->source_x = state.hasSource ? wl_fixed_to_double(state.sourceX) : 0;
+    viewport->source_y = state.hasSource ? wl_fixed_to_double(state.sourceY) : 0;
+    viewport->source_width = state.hasSource ? wl_fixed_to_double(state.sourceWidth) : 0;
+    viewport->source_height = state.hasSource ? wl_fixed_to_double(state.sourceHeight) : 0;
+    viewport->destination_width = state.destinationWidth;
+    viewport->destination_height = state.destinationHeight;
+}
+
+void ViewBackend::fillOpaqueRegion(std::vector<struct wpe_fdo_rectangle>& opaqueRegion) const
+{
+    opaqueRegion.clear();
+    for (auto& rect : m_committedState.opaqueRegion.rects())
+        opaqueRegion.push_back({ rect.x, rect.y, rect.width, rect.height });
+}
+
+void ViewBackend::fillShmDmabuf(struct wl_resource* bufferResource, struct wpe_fdo_shm_dmabuf_attributes* dmabuf) const
+{
+    dmabuf->fd = -1;
+
+    auto& impl = WS::Instance::singleton().impl();
+    if (impl.type() == WS::ImplementationType::SHM)
+        static_cast<WS::ImplSHM&>(impl).exportDmabuf(bufferResource, *dmabuf);
+}
+
+void ViewBackend::fillShmData(struct wpe_fdo_shm_exported_buffer* buffer) const
+{
+    auto& impl = WS::Instance::singleton().impl();
+    if (impl.type() == WS::ImplementationType::SHM) {
+        size_t offset = 0;
+        buffer->mapping = static_cast<WS::ImplSHM&>(impl).sealedMapping(buffer->resource, offset);
+        if (buffer->mapping) {
+            buffer->data = static_cast<const uint8_t*>(buffer->mapping.get()) + offset;
+            return;
+        }
+    }
+
+    // The pool reference keeps libwayland from remapping the pool memory
+    // while the buffer is exported.
+    buffer->pool = wl_shm_buffer_ref_pool(buffer->shm_buffer);
+    buffer->data = wl_shm_buffer_get_data(buffer->shm_buffer);
+}
+
+void ViewBackend::setRenderScaleHint(float scale)
+{
+    m_preferredScale = std::max<uint32_t>(1, std::lround(scale * 120));
+
+    if (!m_bridgeIds.empty()) {
+        if (auto* surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back()))
+            surface->setPreferredScale(m_preferredScale);
+    }
+}
+
+void ViewBackend::setOutputProperties(int32_t scale, int32_t transform)
+{
+    m_output.scale = scale;
+    m_output.transform = transform;
+
+    if (!m_bridgeIds.empty()) {
+        if (auto* surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back()))
+            WS::Instance::singleton().setOutputProperties(*surface, m_output.scale, m_output.transform);
+    }
+}
+
+void ViewBackend::dispatchFrameTiming(uint64_t refreshInterval, uint64_t presentationTime, uint64_t deadline)
+{
+    if (m_bridgeIds.empty())
+        return;
+
+    if (auto* surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back()))
+        WS::Instance::singleton().sendFrameTiming(*surface, refreshInterval, presentationTime, deadline);
+}
+
+void ViewBackend::setVisible(bool visible)
+{
+    if (visible == m_visibility.visible)
+        return;
+
+    m_visibility.visible = visible;
+    updateHiddenFrameSource();
+
+    WS::Surface* surface = nullptr;
+    if (!m_bridgeIds.empty())
+        surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back());
+
+    if (!visible) {
+        // The embedder may stop completing frames while the view is hidden,
+        // so a buffer waiting for it in mailbox mode could be held forever:
+        // hand it back to the client.
+        dropMailboxExport(true);
+
+        // Layer buffers the embedder stopped presenting are not needed anymore.
+        if (surface)
+            WS::Subsurface::releaseRetiredBuffers(*surface);
+        return;
+    }
+
+    // Frames exported before the view was hidden are not waited for anymore.
+    m_mailbox.busy = false;
+
+    // Export the newest buffer committed while hidden, which unblocks the
+    // client once the embedder completes the frame. Without one, the client
+    // may render right away.
+    if (m_mailbox.hasPending) {
+        if (m_clientBundle->presentationMode == WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_MAILBOX)
+            m_mailbox.busy = true;
+        performMailboxExport();
+        if (m_clientBundle->presentationMode != WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_MAILBOX)
+            return;
+    }
+
+    if (surface && WS::Instance::singleton().dispatchFrameCallbacks(surface->bridgeId))
+        m_statistics.frameCallbacksDispatched();
+}
+
+void ViewBackend::setHiddenFrameInterval(uint32_t interval)
+{
+    m_visibility.frameInterval = interval;
+    updateHiddenFrameSource();
+}
+
+void ViewBackend::updateHiddenFrameSource()
+{
+    if (m_visibility.frameSource) {
+        g_source_destroy(m_visibility.frameSource);
+        g_source_unref(m_visibility.frameSource);
+        m_visibility.frameSource = nullptr;
+    }
+
+    if (m_visibility.visible || !m_visibility.frameInterval)
+        return;
+
+    m_visibility.frameSource = g_timeout_source_new(m_visibility.frameInterval);
+    g_source_set_name(m_visibility.frameSource, "WPEBackend-fdo::hidden-frames");
+    g_source_set_callback(m_visibility.frameSource,
+        [](gpointer data) -> gboolean
+        {
+            auto& viewBackend = *static_cast<ViewBackend*>(data);
+            if (!viewBackend.m_bridgeIds.empty()) {
+                if (WS::Instance::singleton().dispatchFrameCallbacks(viewBackend.m_bridgeIds.back()))
+                    viewBackend.m_statistics.frameCallbacksDispatched();
+            }
+            return G_SOURCE_CONTINUE;
+        }, this, nullptr);
+    g_source_attach(m_visibility.frameSource, g_main_context_get_thread_default());
+}
+
+void ViewBackend::trackBufferRelease(struct wl_resource* bufferResource)
+{
+    if (!m_committedSync.release)
+        return;
+
+    wl_resource_set_user_data(m_committedSync.release, bufferResource);
+    wl_list_insert(m_bufferReleases.prev, wl_resource_get_link(m_committedSync.release));
+    m_committedSync.release = nullptr;
+}
+
+void ViewBackend::discardCommittedSync()
+{
+    if (m_committedSync.acquireFence != -1) {
+        close(m_committedSync.acquireFence);
+        m_committedSync.acquireFence = -1;
+    }
+
+    if (m_committedSync.release) {
+        WS::sendBufferRelease(m_committedSync.release, -1);
+        m_committedSync.release = nullptr;
+    }
 }
 
 void ViewBackend::dispatchFrameCallbacks()
 {
+    // Layer buffers replaced since the previous frame are not presented anymore.
+    if (!m_bridgeIds.empty()) {
+        if (auto* surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back()))
+            WS::Subsurface::releaseRetiredBuffers(*surface);
+    }
+
+    // Frame callbacks of hidden views are paced by the hidden frame interval.
+    if (!m_visibility.visible) {
+        m_mailbox.busy = false;
+        return;
+    }
+
+    // The embedder is done with the previous buffer, hand over the newest one.
+    if (m_mailbox.busy) {
+        m_mailbox.busy = false;
+        if (m_mailbox.hasPending) {
+            m_mailbox.busy = true;
+            performMailboxExport();
+        }
+
+        wpe_view_backend_dispatch_frame_displayed(m_backend);
+        return;
+    }
+
     if (G_LIKELY(!m_bridgeIds.empty())) {
-        if (WS::Instance::singleton().dispatchFrameCallbacks(m_bridgeIds.back()))
+        if (WS::Instance::singleton().dispatchFrameCallbacks(m_bridgeIds.back())) {
+            m_statistics.frameCallbacksDispatched();
             wpe_view_backend_dispatch_frame_displayed(m_backend);
+        }
     }
 }
 
-void ViewBackend::releaseBuffer(struct wl_resource* buffer_resource)
+void ViewBackend::releaseBuffer(struct wl_resource* buffer_resource, int releaseFence)
 {
+    struct wl_resource* bufferRelease = nullptr;
+    struct wl_resource* release;
+    wl_resource_for_each(release, &m_bufferReleases) {
+        if (wl_resource_get_user_data(release) == buffer_resource) {
+            bufferRelease = release;
+            break;
+        }
+    }
+
+    // Without a release object the client relies on implicit synchronization,
+    // so the fence is not needed.
+    if (bufferRelease)
+        WS::sendBufferRelease(bufferRelease, releaseFence);
+    if (releaseFence != -1)
+        close(releaseFence);
+
+#if defined(WPE_FDO_TRACING)
+    if (!m_bridgeIds.empty()) {
+        if (auto* surface = WS::Instance::singleton().surfaceForBridge(m_bridgeIds.back()))
+            WS_TRACE_MARK("releaseBuffer", surface->bridgeId, surface->frameForBuffer(buffer_resource));
+    }
+#endif
+
     wl_buffer_send_release(buffer_resource);
     wl_client_flush(wl_resource_get_client(buffer_resource));
 }
@@ -120,6 +507,11 @@ void ViewBackend::registerSurface(uint32_t bridgeId)
 {
     m_bridgeIds.push_back(bridgeId);
     WS::Instance::singleton().registerViewBackend(m_bridgeIds.back(), *this);
+
+    if (auto* surface = WS::Instance::singleton().surfaceForBridge(bridgeId)) {
+        surface->setPreferredScale(m_preferredScale);
+        WS::Instance::singleton().setOutputProperties(*surface, m_output.scale, m_output.transform);
+    }
 }
 
 void ViewBackend::unregisterSurface(uint32_t bridgeId)
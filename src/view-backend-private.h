@@ -25,8 +25,13 @@
 
 #pragma once
 
+#include "../include/wpe/exported-buffer-shm.h"
+#include "../include/wpe/view-backend-exportable.h"
+#include "../include/wpe/viewport.h"
 #include "ipc.h"
+#include "view-backend-statistics.h"
 #include "ws.h"
+#include "ws-subsurface.h"
 
 #include <gio/gio.h>
 #include <wpe/wpe.h>
@@ -51,13 +56,21 @@ public:
     virtual void exportBuffer(struct wl_resource* bufferResource, struct wl_shm_buffer* shmBuffer) = 0;
     virtual void exportEGLStreamProducer(struct wl_resource *bufferResource) = 0;
 
-    virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() = 0;
+    virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t width, uint32_t height, uint32_t format) = 0;
     virtual void commitDmabufPoolEntry(struct wpe_dmabuf_pool_entry*) = 0;
 
+    // Sub-surface layers of the view, bottom to top. Only meaningful for
+    // bundles which expose layers to the embedder.
+    virtual void layersUpdated(const std::vector<WS::Layer>&) { }
+
+    // Releases resources cached for buffers which are not exported.
+    virtual void trimMemory(WS::TrimMemoryLevel) { }
+
     void* data;
     ViewBackend* viewBackend;
     uint32_t initialWidth;
     uint32_t initialHeight;
+    enum wpe_view_backend_exportable_fdo_presentation_mode presentationMode { WPE_VIEW_BACKEND_EXPORTABLE_FDO_PRESENTATION_MODE_FIFO };
 };
 
 class ViewBackend final : public WS::APIClient, public FdoIPC::MessageReceiver {
@@ -72,16 +85,52 @@ public:
     void exportShmBuffer(struct wl_resource* bufferResource, struct wl_shm_buffer* shmBuffer) override;
     void exportEGLStreamProducer(struct wl_resource*) override;
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() override;
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t width, uint32_t height, uint32_t format) override;
     void commitDmabufPoolEntry(struct wpe_dmabuf_pool_entry*) override;
 
+    void surfaceCommitted(struct wl_resource*, WS::BufferSync&&, const WS::BufferState&) override;
+    void layersChanged(WS::Surface&) override;
+
+    void trimMemory(WS::TrimMemoryLevel level) override
+    {
+        m_clientBundle->trimMemory(level);
+    }
+
     void bridgeConnectionLost(uint32_t id) override
     {
          unregisterSurface(id);
     }
 
     void dispatchFrameCallbacks();
-    void releaseBuffer(struct wl_resource* buffer_resource);
+    void releaseBuffer(struct wl_resource* buffer_resource, int releaseFence = -1);
+
+    // Hands over the acquire fence of the buffer being exported, if the client
+    // provided one. The caller takes ownership of the returned fd.
+    int takeAcquireFence();
+
+    // Describes the cropping and scaling of the buffer being exported.
+    void fillViewport(struct wpe_fdo_viewport*) const;
+    // Opaque region of the buffer being exported, empty when unknown.
+    void fillOpaqueRegion(std::vector<struct wpe_fdo_rectangle>&) const;
+    // Leaves the file descriptor at -1 when the buffer has no dma-buf.
+    void fillShmDmabuf(struct wl_resource*, struct wpe_fdo_shm_dmabuf_attributes*) const;
+    void fillShmData(struct wpe_fdo_shm_exported_buffer*) const;
+
+    // Preferred render scale suggested to the client, 1.0 by default.
+    void setRenderScaleHint(float);
+
+    // While hidden, committed buffers are held instead of exported, and frame
+    // callbacks are sent every hidden frame interval (in ms) if not zero.
+    void setVisible(bool);
+    void setHiddenFrameInterval(uint32_t);
+
+    // Scale and wl_output_transform of the display the view is presented on.
+    void setOutputProperties(int32_t scale, int32_t transform);
+
+    // Display timing of the next frame, forwarded to the client as is.
+    void dispatchFrameTiming(uint64_t refreshInterval, uint64_t presentationTime, uint64_t deadline);
+
+    ViewBackendStatistics& statistics() { return m_statistics; }
 
 private:
     void didReceiveMessage(uint32_t messageId, uint32_t messageBody) override;
@@ -89,6 +138,29 @@ private:
     void registerSurface(uint32_t);
     void unregisterSurface(uint32_t);
 
+    struct Export {
+        enum class Type { BufferResource, LinuxDmabuf, ShmBuffer, DmabufPoolEntry };
+        Type type { Type::BufferResource };
+        struct wl_resource* bufferResource { nullptr };
+        const struct linux_dmabuf_buffer* dmabufBuffer { nullptr };
+        struct wl_shm_buffer* shmBuffer { nullptr };
+        struct wpe_dmabuf_pool_entry* entry { nullptr };
+    };
+    void submitExport(const Export&);
+    void performExport(const Export&);
+    void performMailboxExport();
+    void dropMailboxExport(bool releaseBuffer);
+    void updateHiddenFrameSource();
+
+    struct MailboxDestroyListener {
+        struct wl_listener listener;
+        ViewBackend* viewBackend;
+    };
+    static void mailboxBufferDestroyed(struct wl_listener*, void*);
+
+    void trackBufferRelease(struct wl_resource* bufferResource);
+    void discardCommittedSync();
+
     static gboolean s_socketCallback(GSocket*, GIOCondition, gpointer);
 
     std::vector<uint32_t> m_bridgeIds;
@@ -98,6 +170,47 @@ private:
 
     std::unique_ptr<FdoIPC::Connection> m_socket;
     int m_clientFd { -1 };
+
+    ViewBackendStatistics m_statistics;
+
+    // Whether the last layer list handed to the client bundle was not empty.
+    bool m_hasLayers { false };
+
+    // Explicit synchronization state of the last commit, consumed when the
+    // buffer is exported. Release resources for exported buffers are kept in
+    // m_bufferReleases, with the buffer resource as their user data.
+    WS::BufferSync m_committedSync;
+    struct wl_list m_bufferReleases;
+
+    // Presentation state of the last commit, kept along with the pending
+    // buffer in mailbox mode.
+    WS::BufferState m_committedState;
+
+    // Render scale hint, in 1/120 units as in wp_fractional_scale_v1.
+    uint32_t m_preferredScale { 120 };
+
+    struct {
+        int32_t scale { 1 };
+        int32_t transform { WL_OUTPUT_TRANSFORM_NORMAL };
+    } m_output;
+
+    struct {
+        bool visible { true };
+        uint32_t frameInterval { 1000 };
+        GSource* frameSource { nullptr };
+    } m_visibility;
+
+    // Mailbox presentation: whether the embedder is consuming an exported
+    // buffer, and the newest buffer committed meanwhile, if any. Hidden views
+    // keep the newest buffer here as well.
+    struct {
+        bool busy { false };
+        bool hasPending { false };
+        Export pending;
+        WS::BufferSync pendingSync;
+        WS::BufferState pendingState;
+        MailboxDestroyListener destroyListener;
+    } m_mailbox;
 };
 
 struct wpe_view_backend_private {
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "view-backend-statistics.h"
+
+#include "../include/wpe/view-backend-exportable.h"
+#include "ws.h"
+#include "ws-egl.h"
+#include <algorithm>
+#include <glib.h>
+
+static const uint32_t s_latencyDecayThreshold = 4096;
+
+ViewBackendStatistics::ViewBackendStatistics()
+{
+    m_latencyHistogram.fill(0);
+}
+
+void ViewBackendStatistics::frameCommitted(struct wl_resource* resource)
+{
+    ++m_framesCommitted;
+
+    if (!resource)
+        return;
+
+    // A buffer superseded before being exported is released without a
+    // sample, so its entry is reused when the client commits it again.
+    auto it = std::find_if(m_pendingBuffers.begin(), m_pendingBuffers.end(),
+        [resource](const PendingBuffer& pending) { return pending.resource == resource; });
+    auto& pending = it != m_pendingBuffers.end() ? *it : m_pendingBuffers[m_pendingBuffersIndex++ % m_pendingBuffers.size()];
+    pending.resource = resource;
+    pending.commitTime = g_get_monotonic_time();
+}
+
+void ViewBackendStatistics::bufferExported(struct wl_resource*, size_t shmSize)
+{
+    ++m_framesExported;
+    m_shmBytesMapped += shmSize;
+}
+
+void ViewBackendStatistics::bufferReleased(struct wl_resource* resource, size_t shmSize)
+{
+    ++m_framesReleased;
+    m_shmBytesMapped -= std::min<uint64_t>(shmSize, m_shmBytesMapped);
+
+    if (!resource)
+        return;
+
+    for (auto& pending : m_pendingBuffers) {
+        if (pending.resource == resource) {
+            addLatencySample(g_get_monotonic_time() - pending.commitTime);
+            pending.resource = nullptr;
+            break;
+        }
+    }
+}
+
+void ViewBackendStatistics::fill(struct wpe_view_backend_exportable_fdo_statistics* statistics) const
+{
+    statistics->frames_committed = m_framesCommitted;
+    statistics->frames_exported = m_framesExported;
+    statistics->frames_released = m_framesReleased;
+    statistics->frame_callbacks_dispatched = m_frameCallbacksDispatched;
+    statistics->buffers_held = m_framesExported > m_framesReleased ? m_framesExported - m_framesReleased : 0;
+    statistics->shm_bytes_mapped = m_shmBytesMapped;
+    statistics->commit_to_release_latency_p50 = latencyPercentile(50);
+    statistics->commit_to_release_latency_p99 = latencyPercentile(99);
+
+    statistics->egl_images_live = 0;
+    auto& instance = WS::Instance::singleton();
+    if (instance.impl().type() == WS::ImplementationType::EGL)
+        statistics->egl_images_live = WS::instanceImpl<WS::ImplEGL>().liveImageCount();
+}
+
+void ViewBackendStatistics::addLatencySample(int64_t latency)
+{
+    if (m_latencySamples >= s_latencyDecayThreshold) {
+        m_latencySamples = 0;
+        for (auto& count : m_latencyHistogram) {
+            count /= 2;
+            m_latencySamples += count;
+        }
+    }
+
+    ++m_latencyHistogram[latencyBucket(latency > 0 ? latency : 0)];
+    ++m_latencySamples;
+}
+
+uint64_t ViewBackendStatistics::latencyPercentile(unsigned percentile) const
+{
+    if (!m_latencySamples)
+        return 0;
+
+    uint64_t threshold = (uint64_t(m_latencySamples) * percentile + 99) / 100;
+    uint64_t accumulated = 0;
+    for (unsigned i = 0; i < s_latencyBucketCount; ++i) {
+        accumulated += m_latencyHistogram[i];
+        if (accumulated >= threshold && accumulated)
+            return latencyBucketValue(i);
+    }
+    return latencyBucketValue(s_latencyBucketCount - 1);
+}
+
+unsigned ViewBackendStatistics::latencyBucket(uint64_t value)
+{
+    if (value < 16)
+        return value;
+
+    unsigned exponent = 63 - __builtin_clzll(value);
+    unsigned bucket = 16 + (exponent - 4) * 8 + ((value >> (exponent - 3)) & 7);
+    return std::min(bucket, s_latencyBucketCount - 1);
+}
+
+uint64_t ViewBackendStatistics::latencyBucketValue(unsigned bucket)
+{
+    if (bucket < 16)
+        return bucket;
+
+    unsigned exponent = (bucket - 16) / 8 + 4;
+    uint64_t subBucket = (bucket - 16) % 8;
+    // Middle of the range covered by the bucket.
+    return ((8 + subBucket) << (exponent - 3)) + (uint64_t(1) << (exponent - 4));
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct wl_resource;
+struct wpe_view_backend_exportable_fdo_statistics;
+
+// Frame counters for a view backend. Updating them must be cheap enough to
+// leave enabled at all times: every operation is a few integer updates, and
+// latency percentiles come from a fixed-size log-linear histogram.
+class ViewBackendStatistics {
+public:
+    ViewBackendStatistics();
+
+    void frameCommitted(struct wl_resource*);
+    void frameCallbacksDispatched() { ++m_frameCallbacksDispatched; }
+
+    void bufferExported(struct wl_resource*, size_t shmSize = 0);
+    void bufferReleased(struct wl_resource*, size_t shmSize = 0);
+
+    void fill(struct wpe_view_backend_exportable_fdo_statistics*) const;
+
+private:
+    void addLatencySample(int64_t);
+    uint64_t latencyPercentile(unsigned) const;
+
+    static unsigned latencyBucket(uint64_t);
+    static uint64_t latencyBucketValue(unsigned);
+
+    uint64_t m_framesCommitted { 0 };
+    uint64_t m_framesExported { 0 };
+    uint64_t m_framesReleased { 0 };
+    uint64_t m_frameCallbacksDispatched { 0 };
+    uint64_t m_shmBytesMapped { 0 };
+
+    // Commit times of the most recently committed buffers, used to measure
+    // the latency when they are released after being exported, including the
+    // time spent waiting in the mailbox or while the view is hidden. Buffers
+    // held for longer than it takes to fill the ring do not produce a sample.
+    struct PendingBuffer {
+        struct wl_resource* resource { nullptr };
+        int64_t commitTime { 0 };
+    };
+    std::array<PendingBuffer, 8> m_pendingBuffers;
+    unsigned m_pendingBuffersIndex { 0 };
+
+    // Microsecond latencies: exact below 16, then 8 buckets per power of two.
+    // Counts are halved once enough samples accumulate, so that percentiles
+    // follow the recent behaviour of the view.
+    static const unsigned s_latencyBucketCount = 16 + 8 * 36;
+    std::array<uint32_t, s_latencyBucketCount> m_latencyHistogram;
+    uint32_t m_latencySamples { 0 };
+};
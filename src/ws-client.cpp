@@ -25,8 +25,13 @@
 
 #include "ws-client.h"
 
+#include "../include/wpe/viewport.h"
 #include "ipc-messages.h"
+#include "ws-tracing.h"
+#include <algorithm>
 #include <cstring>
+#include <mutex>
+#include <vector>
 
 namespace WS {
 
@@ -116,48 +121,266 @@ GSourceFuncs TargetSource::s_sourceFuncs = {
     nullptr, // closure_marshall
 };
 
+// Reads the display once per main loop iteration on behalf of all the targets
+// attached to the same main context, then dispatches their queues, so that
+// adding views does not add sources polling the same file descriptor.
+struct SharedReaderSource {
+    static GSourceFuncs s_sourceFuncs;
+    static std::mutex s_mutex;
+    static std::vector<GSource*> s_sources;
 
-BaseBackend::BaseBackend(int hostFD)
+    bool prepareRead();
+
+    GSource source;
+    GPollFD pfd;
+    struct wl_display* display;
+    std::vector<struct wl_event_queue*>* queues;
+    bool isReading;
+};
+
+std::mutex SharedReaderSource::s_mutex;
+std::vector<GSource*> SharedReaderSource::s_sources;
+
+bool SharedReaderSource::prepareRead()
 {
-    m_wl.display = wl_display_connect_to_fd(hostFD);
+    // The read intent is registered through the first queue, and held while
+    // the remaining ones are checked, so that no other thread can queue new
+    // events on them before the display is read.
+    if (wl_display_prepare_read_queue(display, queues->front()) != 0)
+        return false;
+
+    for (auto it = queues->begin() + 1; it != queues->end(); ++it) {
+        if (wl_display_prepare_read_queue(display, *it) != 0) {
+            wl_display_cancel_read(display);
+            return false;
+        }
+        wl_display_cancel_read(display);
+    }
+    return true;
+}
 
-    struct wl_registry* registry = wl_display_get_registry(m_wl.display);
-    wl_registry_add_listener(registry, &s_registryListener, this);
-    wl_display_roundtrip(m_wl.display);
-    wl_registry_destroy(registry);
+GSourceFuncs SharedReaderSource::s_sourceFuncs = {
+    // prepare
+    [](GSource* base, gint* timeout) -> gboolean
+    {
+        auto& source = *reinterpret_cast<SharedReaderSource*>(base);
 
-    if (!m_wl.wpeBridge)
-        g_error("Failed to bind wpe_bridge");
+        *timeout = -1;
 
-    wpe_bridge_add_listener(m_wl.wpeBridge, &s_bridgeListener, this);
-    wpe_bridge_initialize(m_wl.wpeBridge);
-    wl_display_roundtrip(m_wl.display);
+        if (source.isReading)
+            return FALSE;
+
+        {
+            // Targets may be added or removed from other threads. Nothing
+            // is dispatched while checking the queues, so the lock is held.
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (source.queues->empty())
+                return FALSE;
+
+            // If any of the queues has pending dispatches we return TRUE to proceed to dispatching ASAP.
+            if (!source.prepareRead())
+                return TRUE;
+        }
+
+        source.isReading = true;
+
+        wl_display_flush(source.display);
+        return FALSE;
+    },
+    // check
+    [](GSource* base) -> gboolean
+    {
+        auto& source = *reinterpret_cast<SharedReaderSource*>(base);
+
+        if (source.isReading) {
+            source.isReading = false;
+
+            if (source.pfd.revents & G_IO_IN) {
+                if (wl_display_read_events(source.display) == 0)
+                    return TRUE;
+            } else
+                wl_display_cancel_read(source.display);
+        }
+
+        return source.pfd.revents;
+    },
+    // dispatch
+    [](GSource* base, GSourceFunc, gpointer) -> gboolean
+    {
+        auto& source = *reinterpret_cast<SharedReaderSource*>(base);
+
+        if (source.pfd.revents & (G_IO_ERR | G_IO_HUP))
+            return FALSE;
+
+        // Dispatching may destroy targets, and with them their queues, so
+        // each one is checked against the current set before being used.
+        // The lock is not held while dispatching, as event handlers may add
+        // or remove targets. Dispatching an empty queue returns right away.
+        std::vector<struct wl_event_queue*> queues;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            queues = *source.queues;
+        }
+        for (auto* queue : queues) {
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                if (std::find(source.queues->begin(), source.queues->end(), queue) == source.queues->end())
+                    continue;
+            }
+            if (wl_display_dispatch_queue_pending(source.display, queue) < 0)
+                return FALSE;
+        }
+
+        source.pfd.revents = 0;
+        return TRUE;
+    },
+    // finalize
+    [](GSource* base)
+    {
+        auto& source = *reinterpret_cast<SharedReaderSource*>(base);
+
+        if (source.isReading) {
+            wl_display_cancel_read(source.display);
+            source.isReading = false;
+        }
+
+        delete source.queues;
+        source.queues = nullptr;
+    },
+    nullptr, // closure_callback
+    nullptr, // closure_marshall
+};
+
+
+BaseBackend::BaseBackend(int hostFD)
+{
+    m_wl.display = wl_display_connect_to_fd(hostFD);
+
+    // Nothing is waited for here: the bridge is bound and initialized from
+    // the registry listener, and the implementation info is only waited for
+    // once it is actually needed, in type(). The registry is kept around to
+    // bind other globals from the collected list later on.
+    //
+    // The registry, and with it the bridge, live on a queue of their own,
+    // which is only dispatched from findGlobal() and type(): their events
+    // neither pile up on the default queue nor get dispatched by whichever
+    // thread happens to dispatch it.
+    m_wl.eventQueue = wl_display_create_queue(m_wl.display);
+    auto* display = static_cast<struct wl_display*>(wl_proxy_create_wrapper(m_wl.display));
+    wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(display), m_wl.eventQueue);
+    m_wl.registry = wl_display_get_registry(display);
+    wl_registry_add_listener(m_wl.registry, &s_registryListener, this);
+    m_wl.registryDone = wl_display_sync(display);
+    wl_callback_add_listener(m_wl.registryDone, &s_registryDoneListener, this);
+    wl_proxy_wrapper_destroy(display);
+    wl_display_flush(m_wl.display);
 }
 
 BaseBackend::~BaseBackend()
 {
+    g_clear_pointer(&m_wl.registryDone, wl_callback_destroy);
+    g_clear_pointer(&m_wl.registry, wl_registry_destroy);
     g_clear_pointer(&m_wl.wpeBridge, wpe_bridge_destroy);
+    g_clear_pointer(&m_wl.eventQueue, wl_event_queue_destroy);
     g_clear_pointer(&m_wl.display, wl_display_disconnect);
 }
 
 const struct wl_registry_listener BaseBackend::s_registryListener = {
     // global
-    [](void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t)
+    [](void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version)
     {
         auto& backend = *reinterpret_cast<BaseBackend*>(data);
+        backend.m_globals.push_back({ name, interface, version });
 
-        if (!std::strcmp(interface, "wpe_bridge"))
-            backend.m_wl.wpeBridge = static_cast<struct wpe_bridge*>(wl_registry_bind(registry, name, &wpe_bridge_interface, 1));
+        if (!std::strcmp(interface, "wpe_bridge") && !backend.m_wl.wpeBridge) {
+            backend.m_wl.wpeBridge = static_cast<struct wpe_bridge*>(wl_registry_bind(registry, name, &wpe_bridge_interface, std::min<uint32_t>(version, 2)));
+            wpe_bridge_add_listener(backend.m_wl.wpeBridge, &s_bridgeListener, &backend);
+            wpe_bridge_initialize(backend.m_wl.wpeBridge);
+        }
     },
     // global_remove
-    [](void*, struct wl_registry*, uint32_t) { },
+    [](void* data, struct wl_registry*, uint32_t name)
+    {
+        auto& globals = reinterpret_cast<BaseBackend*>(data)->m_globals;
+        globals.erase(std::remove_if(globals.begin(), globals.end(),
+            [name](const Global& global) { return global.name == name; }), globals.end());
+    },
+};
+
+const struct wl_callback_listener BaseBackend::s_registryDoneListener = {
+    // done
+    [](void* data, struct wl_callback*, uint32_t)
+    {
+        auto& backend = *reinterpret_cast<BaseBackend*>(data);
+        g_clear_pointer(&backend.m_wl.registryDone, wl_callback_destroy);
+        backend.m_registryComplete = true;
+
+        if (!backend.m_wl.wpeBridge)
+            g_error("Failed to bind wpe_bridge");
+    },
 };
 
+void BaseBackend::dispatchUntil(const bool& condition, const char* waitingFor)
+{
+    while (!condition) {
+        if (wl_display_dispatch_queue(m_wl.display, m_wl.eventQueue) == -1)
+            g_error("BaseBackend: connection lost while waiting for %s", waitingFor);
+    }
+}
+
+bool BaseBackend::findGlobal(const char* interface, Global& result)
+{
+    // Targets and the IO thread look globals up from different threads. The
+    // queue is dispatched with the lock held, so only one of them waits on
+    // the display while the others wait for it to be done.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    dispatchUntil(m_registryComplete, "the registry");
+    if (wl_display_dispatch_queue_pending(m_wl.display, m_wl.eventQueue) == -1)
+        g_error("BaseBackend: connection lost while updating the registry");
+
+    for (auto& global : m_globals) {
+        if (global.interface == interface) {
+            result = global;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t BaseBackend::globalVersion(const char* interface)
+{
+    Global global;
+    return findGlobal(interface, global) ? global.version : 0;
+}
+
+void* BaseBackend::bindGlobal(const struct wl_interface* interface, uint32_t version, struct wl_event_queue* eventQueue)
+{
+    Global global;
+    if (!findGlobal(interface->name, global))
+        return nullptr;
+
+    // Binding through a wrapper places the new object on the queue right
+    // away, before any of its events can be read.
+    auto* registry = static_cast<struct wl_registry*>(wl_proxy_create_wrapper(m_wl.registry));
+    wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(registry), eventQueue);
+    void* object = wl_registry_bind(registry, global.name, interface, std::min(version, global.version));
+    wl_proxy_wrapper_destroy(registry);
+    return object;
+}
+
+ClientImplementationType BaseBackend::type()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    dispatchUntil(m_implementationInfoReceived, "the implementation info");
+    return m_type;
+}
+
 const struct wpe_bridge_listener BaseBackend::s_bridgeListener = {
     // implementation_info
     [](void* data, struct wpe_bridge*, uint32_t implementationType)
     {
         auto& backend = *reinterpret_cast<BaseBackend*>(data);
+        backend.m_implementationInfoReceived = true;
         switch (implementationType) {
         case WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_WAYLAND:
             backend.m_type = ClientImplementationType::Wayland;
@@ -165,12 +388,17 @@ const struct wpe_bridge_listener BaseBackend::s_bridgeListener = {
         case WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_DMABUF_POOL:
             backend.m_type = ClientImplementationType::DmabufPool;
             break;
+        case WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_SHM:
+            backend.m_type = ClientImplementationType::SHM;
+            break;
         default:
             break;
         }
     },
     // connected
     [](void* data, struct wpe_bridge*, uint32_t) { },
+    // frame_timing
+    [](void*, struct wpe_bridge*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) { },
 };
 
 
@@ -186,18 +414,21 @@ BaseTarget::~BaseTarget()
         m_glib.socket->send(FdoIPC::Messages::UnregisterSurface, m_wl.wpeBridgeId);
 
     g_clear_pointer(&m_wl.frameCallback, wl_callback_destroy);
+    g_clear_pointer(&m_wl.surfaceSynchronization, zwp_linux_surface_synchronization_v1_destroy);
     g_clear_pointer(&m_wl.surface, wl_surface_destroy);
     g_clear_pointer(&m_wl.wpeDmabufPool, wpe_dmabuf_pool_destroy);
 
     g_clear_pointer(&m_wl.wpeDmabufPoolManager, wpe_dmabuf_pool_manager_destroy);
+    g_clear_pointer(&m_wl.explicitSynchronization, zwp_linux_explicit_synchronization_v1_destroy);
     g_clear_pointer(&m_wl.wpeBridge, wpe_bridge_destroy);
+    g_clear_pointer(&m_wl.shm, wl_shm_destroy);
     g_clear_pointer(&m_wl.compositor, wl_compositor_destroy);
-    g_clear_pointer(&m_wl.eventQueue, wl_event_queue_destroy);
 
     if (m_glib.wlSource) {
-        g_source_destroy(m_glib.wlSource);
-        g_source_unref(m_glib.wlSource);
+        ws_shared_reader_source_remove(m_glib.wlSource, m_wl.eventQueue);
+        m_glib.wlSource = nullptr;
     }
+    g_clear_pointer(&m_wl.eventQueue, wl_event_queue_destroy);
 }
 
 void BaseTarget::initialize(BaseBackend& backend)
@@ -207,11 +438,16 @@ void BaseTarget::initialize(BaseBackend& backend)
 
     m_wl.eventQueue = wl_display_create_queue(display);
 
-    struct wl_registry* registry = wl_display_get_registry(display);
-    wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(registry), m_wl.eventQueue);
-    wl_registry_add_listener(registry, &s_registryListener, this);
-    wl_display_roundtrip_queue(display, m_wl.eventQueue);
-    wl_registry_destroy(registry);
+    m_wl.compositor = static_cast<struct wl_compositor*>(backend.bindGlobal(&wl_compositor_interface, 4, m_wl.eventQueue));
+    m_wl.shm = static_cast<struct wl_shm*>(backend.bindGlobal(&wl_shm_interface, 1, m_wl.eventQueue));
+    if (m_wl.shm)
+        wl_shm_add_listener(m_wl.shm, &s_shmListener, this);
+    m_wl.wpeBridge = static_cast<struct wpe_bridge*>(backend.bindGlobal(&wpe_bridge_interface, 3, m_wl.eventQueue));
+    m_wl.wpeDmabufPoolManager = static_cast<struct wpe_dmabuf_pool_manager*>(backend.bindGlobal(&wpe_dmabuf_pool_manager_interface, 3, m_wl.eventQueue));
+    if (backend.globalVersion("zwp_linux_explicit_synchronization_v1") >= 2) {
+        m_wl.explicitSynchronization = static_cast<struct zwp_linux_explicit_synchronization_v1*>(
+            backend.bindGlobal(&zwp_linux_explicit_synchronization_v1_interface, 2, m_wl.eventQueue));
+    }
 
     if (!m_wl.compositor)
         g_error("Failed to bind wl_compositor");
@@ -223,26 +459,74 @@ void BaseTarget::initialize(BaseBackend& backend)
 
     m_wl.wpeDmabufPool = wpe_dmabuf_pool_manager_create_pool(m_wl.wpeDmabufPoolManager, m_wl.surface);
     wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(m_wl.wpeDmabufPool), m_wl.eventQueue);
+    wpe_dmabuf_pool_add_listener(m_wl.wpeDmabufPool, &s_dmabufPoolListener, this);
 
-    m_glib.wlSource = ws_polling_source_new("WPEBackend-fdo::wayland", display, m_wl.eventQueue);
-    g_source_attach(m_glib.wlSource, g_main_context_get_thread_default());
+    if (m_wl.explicitSynchronization) {
+        m_wl.surfaceSynchronization = zwp_linux_explicit_synchronization_v1_get_synchronization(m_wl.explicitSynchronization, m_wl.surface);
+        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(m_wl.surfaceSynchronization), m_wl.eventQueue);
+    }
 
+    m_glib.wlSource = ws_shared_reader_source_add(display, m_wl.eventQueue);
+
+    // The connection completes in the background, and is only waited for
+    // before the first frame, if it has not arrived by then.
     wpe_bridge_add_listener(m_wl.wpeBridge, &s_bridgeListener, this);
     wpe_bridge_connect(m_wl.wpeBridge, m_wl.surface);
-    wl_display_roundtrip_queue(display, m_wl.eventQueue);
+    wl_display_flush(display);
+}
+
+void BaseTarget::waitForConnection()
+{
+    while (!m_wl.wpeBridgeId) {
+        if (wl_display_dispatch_queue(display(), m_wl.eventQueue) == -1)
+            g_error("BaseTarget: connection lost while waiting for the bridge connection");
+    }
+}
+
+bool BaseTarget::supportsShmFormat(uint32_t format) const
+{
+    // ARGB8888 and XRGB8888 are supported by all wl_shm implementations.
+    if (format == WL_SHM_FORMAT_ARGB8888 || format == WL_SHM_FORMAT_XRGB8888)
+        return true;
+    return std::find(m_wl.shmFormats.begin(), m_wl.shmFormats.end(), format) != m_wl.shmFormats.end();
+}
+
+void BaseTarget::damageBuffer(const struct wpe_fdo_rectangle* damage, uint32_t count)
+{
+    // Without damage_buffer, surface coordinates match the buffer ones as
+    // long as no scale or transform is set, which targets do not do.
+    bool useDamageBuffer = wl_proxy_get_version(reinterpret_cast<struct wl_proxy*>(m_wl.surface)) >= WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION;
+    if (!count) {
+        if (useDamageBuffer)
+            wl_surface_damage_buffer(m_wl.surface, 0, 0, INT32_MAX, INT32_MAX);
+        else
+            wl_surface_damage(m_wl.surface, 0, 0, INT32_MAX, INT32_MAX);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (useDamageBuffer)
+            wl_surface_damage_buffer(m_wl.surface, damage[i].x, damage[i].y, damage[i].width, damage[i].height);
+        else
+            wl_surface_damage(m_wl.surface, damage[i].x, damage[i].y, damage[i].width, damage[i].height);
+    }
 }
 
 void BaseTarget::requestFrame()
 {
+    waitForConnection();
+
     if (m_wl.frameCallback)
         g_error("BaseTarget::requestFrame(): A frame callback was already installed.");
 
     m_wl.frameCallback = wl_surface_frame(m_wl.surface);
     wl_callback_add_listener(m_wl.frameCallback, &s_callbackListener, this);
+    ++m_frameSequence;
 }
 
 void BaseTarget::frameComplete()
 {
+    WS_TRACE_MARK("frameComplete", m_wl.wpeBridgeId, m_frameSequence);
     g_clear_pointer(&m_wl.frameCallback, wl_callback_destroy);
     m_impl.dispatchFrameComplete();
 }
@@ -254,23 +538,6 @@ void BaseTarget::bridgeConnected(uint32_t bridgeID)
         m_glib.socket->send(FdoIPC::Messages::RegisterSurface, bridgeID);
 }
 
-const struct wl_registry_listener BaseTarget::s_registryListener = {
-    // global
-    [](void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t)
-    {
-        auto& target = *reinterpret_cast<BaseTarget*>(data);
-
-        if (!std::strcmp(interface, "wl_compositor"))
-            target.m_wl.compositor = static_cast<struct wl_compositor*>(wl_registry_bind(registry, name, &wl_compositor_interface, 1));
-        if (!std::strcmp(interface, "wpe_bridge"))
-            target.m_wl.wpeBridge = static_cast<struct wpe_bridge*>(wl_registry_bind(registry, name, &wpe_bridge_interface, 1));
-        if (!std::strcmp(interface, "wpe_dmabuf_pool_manager"))
-            target.m_wl.wpeDmabufPoolManager = static_cast<struct wpe_dmabuf_pool_manager*>(wl_registry_bind(registry, name, &wpe_dmabuf_pool_manager_interface, 1));
-    },
-    // global_remove
-    [](void*, struct wl_registry*, uint32_t) { },
-};
-
 const struct wl_callback_listener BaseTarget::s_callbackListener = {
     // done
     [](void* data, struct wl_callback*, uint32_t time)
@@ -279,6 +546,14 @@ const struct wl_callback_listener BaseTarget::s_callbackListener = {
     },
 };
 
+const struct wl_shm_listener BaseTarget::s_shmListener = {
+    // format
+    [](void* data, struct wl_shm*, uint32_t format)
+    {
+        static_cast<BaseTarget*>(data)->m_wl.shmFormats.push_back(format);
+    },
+};
+
 const struct wpe_bridge_listener BaseTarget::s_bridgeListener = {
     // implementation_info
     [](void*, struct wpe_bridge*, uint32_t) { },
@@ -287,6 +562,24 @@ const struct wpe_bridge_listener BaseTarget::s_bridgeListener = {
     {
         static_cast<BaseTarget*>(data)->bridgeConnected(id);
     },
+    // frame_timing
+    [](void* data, struct wpe_bridge*, uint32_t refreshInterval, uint32_t presentationTimeHi, uint32_t presentationTimeLo, uint32_t deadlineHi, uint32_t deadlineLo)
+    {
+        auto& timing = static_cast<BaseTarget*>(data)->m_frameTiming;
+        timing.refreshInterval = refreshInterval;
+        timing.presentationTime = (uint64_t(presentationTimeHi) << 32) | presentationTimeLo;
+        timing.deadline = (uint64_t(deadlineHi) << 32) | deadlineLo;
+    },
+};
+
+const struct wpe_dmabuf_pool_listener BaseTarget::s_dmabufPoolListener = {
+    // trim
+    [](void* data, struct wpe_dmabuf_pool*, uint32_t level)
+    {
+        auto& target = *static_cast<BaseTarget*>(data);
+        target.m_impl.dispatchTrimMemory(level == WPE_DMABUF_POOL_TRIM_LEVEL_CRITICAL
+            ? TrimMemoryLevel::Critical : TrimMemoryLevel::Moderate);
+    },
 };
 
 
@@ -307,4 +600,57 @@ GSource* ws_polling_source_new(const char* name, struct wl_display* display, str
     return wlSource;
 }
 
+GSource* ws_shared_reader_source_add(struct wl_display* display, struct wl_event_queue* eventQueue)
+{
+    GMainContext* context = g_main_context_get_thread_default();
+    if (!context)
+        context = g_main_context_default();
+
+    std::lock_guard<std::mutex> lock(SharedReaderSource::s_mutex);
+
+    GSource* wlSource = nullptr;
+    for (auto* candidate : SharedReaderSource::s_sources) {
+        if (g_source_is_destroyed(candidate) || g_source_get_context(candidate) != context
+            || reinterpret_cast<SharedReaderSource*>(candidate)->display != display)
+            continue;
+        wlSource = g_source_ref(candidate);
+        break;
+    }
+
+    if (!wlSource) {
+        wlSource = g_source_new(&SharedReaderSource::s_sourceFuncs, sizeof(SharedReaderSource));
+        auto& source = *reinterpret_cast<SharedReaderSource*>(wlSource);
+        source.pfd.fd = wl_display_get_fd(display);
+        source.pfd.events = G_IO_IN | G_IO_ERR | G_IO_HUP;
+        source.pfd.revents = 0;
+        source.display = display;
+        source.queues = new std::vector<struct wl_event_queue*>;
+        source.isReading = false;
+
+        g_source_add_poll(wlSource, &source.pfd);
+        g_source_set_name(wlSource, "WPEBackend-fdo::wayland");
+        g_source_set_can_recurse(wlSource, TRUE);
+        g_source_attach(wlSource, context);
+        SharedReaderSource::s_sources.push_back(wlSource);
+    }
+
+    reinterpret_cast<SharedReaderSource*>(wlSource)->queues->push_back(eventQueue);
+    return wlSource;
+}
+
+void ws_shared_reader_source_remove(GSource* wlSource, struct wl_event_queue* eventQueue)
+{
+    std::lock_guard<std::mutex> lock(SharedReaderSource::s_mutex);
+
+    auto& queues = *reinterpret_cast<SharedReaderSource*>(wlSource)->queues;
+    queues.erase(std::remove(queues.begin(), queues.end(), eventQueue), queues.end());
+
+    if (queues.empty()) {
+        auto& sources = SharedReaderSource::s_sources;
+        sources.erase(std::remove(sources.begin(), sources.end(), wlSource), sources.end());
+        g_source_destroy(wlSource);
+    }
+    g_source_unref(wlSource);
+}
+
 } // namespace WS
@@ -25,13 +25,19 @@
 
 #pragma once
 
+#include "linux-explicit-synchronization-unstable-v1-client-protocol.h"
 #include "wpe-bridge-client-protocol.h"
 #include "wpe-dmabuf-pool-client-protocol.h"
 #include "ipc.h"
 #include "ws-types.h"
 #include <glib.h>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <wayland-client.h>
 
+struct wpe_fdo_rectangle;
+
 namespace WS {
 
 class BaseBackend {
@@ -42,18 +48,50 @@ protected:
 public:
     struct wl_display* display() const { return m_wl.display; }
 
-    ClientImplementationType type() const { return m_type; }
+    // Waits for the host to send it, if it has not arrived yet.
+    ClientImplementationType type();
+
+    // Globals are looked up in the list collected by the registry pass done
+    // when the backend is created, waiting for it to complete if needed. Both
+    // can be used from any thread. globalVersion() returns 0 for globals not
+    // advertised by the host, and bindGlobal() nullptr; the bound object uses
+    // the given queue, or the default one.
+    uint32_t globalVersion(const char* interface);
+    void* bindGlobal(const struct wl_interface*, uint32_t version, struct wl_event_queue* = nullptr);
+
+    // DRM fourcc code targets should render into, or 0 for the default.
+    uint32_t preferredFormat() const { return m_preferredFormat; }
+    void setPreferredFormat(uint32_t format) { m_preferredFormat = format; }
 
 private:
+    struct Global {
+        uint32_t name;
+        std::string interface;
+        uint32_t version;
+    };
+    // Both expect m_mutex to be held.
+    void dispatchUntil(const bool& condition, const char* waitingFor);
+    bool findGlobal(const char* interface, Global&);
+
     static const struct wl_registry_listener s_registryListener;
+    static const struct wl_callback_listener s_registryDoneListener;
     static const struct wpe_bridge_listener s_bridgeListener;
 
     struct {
         struct wl_display* display;
+        struct wl_event_queue* eventQueue { nullptr };
+        struct wl_registry* registry { nullptr };
+        struct wl_callback* registryDone { nullptr };
         struct wpe_bridge* wpeBridge { nullptr };
     } m_wl;
 
+    // Guards everything updated from the listeners of the backend queue.
+    std::mutex m_mutex;
+    std::vector<Global> m_globals;
+    bool m_registryComplete { false };
+    bool m_implementationInfoReceived { false };
     ClientImplementationType m_type { ClientImplementationType::Invalid };
+    uint32_t m_preferredFormat { 0 };
 };
 
 class BaseTarget {
@@ -62,13 +100,38 @@ public:
     public:
         virtual ~Impl() = default;
         virtual void dispatchFrameComplete() = 0;
+        virtual void dispatchTrimMemory(TrimMemoryLevel) = 0;
     };
 
     struct wl_display* display() const { return m_backend->display(); }
     struct wl_event_queue* eventQueue() const { return m_wl.eventQueue; }
     struct wl_surface* surface() const { return m_wl.surface; }
     struct wpe_dmabuf_pool* wpeDmabufPool() const { return m_wl.wpeDmabufPool; }
+    // Only available when the host supports shared memory buffers.
+    struct wl_shm* shm() const { return m_wl.shm; }
+    bool supportsShmFormat(uint32_t) const;
+    // Only available when the host supports explicit synchronization.
+    struct zwp_linux_surface_synchronization_v1* surfaceSynchronization() const { return m_wl.surfaceSynchronization; }
+
+    // Display timing last sent by the host, in CLOCK_MONOTONIC nanoseconds;
+    // all zero until the embedder provides it.
+    struct FrameTiming {
+        uint64_t refreshInterval { 0 };
+        uint64_t presentationTime { 0 };
+        uint64_t deadline { 0 };
+    };
+    const FrameTiming& frameTiming() const { return m_frameTiming; }
+
+    uint32_t bridgeId() const { return m_wl.wpeBridgeId; }
+    uint64_t frameSequence() const { return m_frameSequence; }
+    uint32_t preferredFormat() const { return m_backend->preferredFormat(); }
+
+    // Damages the given rectangles of the attached buffer, in buffer
+    // coordinates, or the whole buffer if there are none.
+    void damageBuffer(const struct wpe_fdo_rectangle*, uint32_t count);
 
+    // Called before committing the first frame; requestFrame() does it already.
+    void waitForConnection();
     void requestFrame();
 
 protected:
@@ -81,12 +144,15 @@ private:
     void frameComplete();
     void bridgeConnected(uint32_t bridgeID);
 
-    static const struct wl_registry_listener s_registryListener;
     static const struct wl_callback_listener s_callbackListener;
+    static const struct wl_shm_listener s_shmListener;
     static const struct wpe_bridge_listener s_bridgeListener;
+    static const struct wpe_dmabuf_pool_listener s_dmabufPoolListener;
 
     Impl& m_impl;
     BaseBackend* m_backend { nullptr };
+    uint64_t m_frameSequence { 0 };
+    FrameTiming m_frameTiming;
 
     struct {
         std::unique_ptr<FdoIPC::Connection> socket;
@@ -96,16 +162,27 @@ private:
     struct {
         struct wl_event_queue* eventQueue { nullptr };
         struct wl_compositor* compositor { nullptr };
+        struct wl_shm* shm { nullptr };
         struct wpe_bridge* wpeBridge { nullptr };
         struct wpe_dmabuf_pool_manager* wpeDmabufPoolManager { nullptr };
+        struct zwp_linux_explicit_synchronization_v1* explicitSynchronization { nullptr };
 
         uint32_t wpeBridgeId { 0 };
         struct wl_surface* surface { nullptr };
         struct wpe_dmabuf_pool* wpeDmabufPool { nullptr };
+        struct zwp_linux_surface_synchronization_v1* surfaceSynchronization { nullptr };
         struct wl_callback* frameCallback { nullptr };
+
+        std::vector<uint32_t> shmFormats;
     } m_wl;
 };
 
 GSource* ws_polling_source_new(const char* name, struct wl_display*, struct wl_event_queue*);
 
+// Registers the queue with the reader shared by the targets of the thread-default
+// main context, creating and attaching it if needed. The returned reference is
+// given back with ws_shared_reader_source_remove().
+GSource* ws_shared_reader_source_add(struct wl_display*, struct wl_event_queue*);
+void ws_shared_reader_source_remove(GSource*, struct wl_event_queue*);
+
 } // namespace WS
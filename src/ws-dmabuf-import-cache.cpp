@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ws-dmabuf-import-cache.h"
+
+#include <cassert>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#ifndef DMA_BUF_MAGIC
+#define DMA_BUF_MAGIC 0x444d4142
+#endif
+
+namespace WS {
+
+bool DmabufImportCache::Key::operator==(const Key& other) const
+{
+    if (width != other.width || height != other.height || format != other.format || numPlanes != other.numPlanes)
+        return false;
+
+    for (unsigned i = 0; i < numPlanes; ++i) {
+        const auto& a = planes[i];
+        const auto& b = other.planes[i];
+        if (a.device != b.device || a.inode != b.inode || a.offset != b.offset
+            || a.stride != b.stride || a.modifier != b.modifier)
+            return false;
+    }
+    return true;
+}
+
+size_t DmabufImportCache::Key::Hash::operator()(const Key& key) const
+{
+    auto combine = [](size_t seed, uint64_t value) -> size_t {
+        return seed ^ (std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    };
+
+    size_t hash = combine(0, (uint64_t(key.width) << 32) | key.height);
+    hash = combine(hash, (uint64_t(key.format) << 32) | key.numPlanes);
+    for (unsigned i = 0; i < key.numPlanes; ++i) {
+        hash = combine(hash, key.planes[i].inode);
+        hash = combine(hash, key.planes[i].device);
+        hash = combine(hash, (uint64_t(key.planes[i].offset) << 32) | key.planes[i].stride);
+        hash = combine(hash, key.planes[i].modifier);
+    }
+    return hash;
+}
+
+bool DmabufImportCache::computeKey(Key& key, uint32_t width, uint32_t height, uint32_t format, unsigned numPlanes,
+    const int* fds, const uint32_t* offsets, const uint32_t* strides, const uint64_t* modifiers)
+{
+    if (!numPlanes || numPlanes > key.planes.size())
+        return false;
+
+    key.width = width;
+    key.height = height;
+    key.format = format;
+    key.numPlanes = numPlanes;
+
+    for (unsigned i = 0; i < numPlanes; ++i) {
+        // Before Linux 5.3 all dma-bufs share the same anonymous inode, which
+        // makes the inode number useless to tell buffers apart. Only trust it
+        // when the file lives in the dedicated dma-buf pseudo-filesystem.
+        struct statfs fsInfo;
+        if (fstatfs(fds[i], &fsInfo) == -1 || fsInfo.f_type != DMA_BUF_MAGIC)
+            return false;
+
+        struct stat info;
+        if (fstat(fds[i], &info) == -1)
+            return false;
+
+        key.planes[i].device = info.st_dev;
+        key.planes[i].inode = info.st_ino;
+        key.planes[i].offset = offsets[i];
+        key.planes[i].stride = strides[i];
+        key.planes[i].modifier = modifiers ? modifiers[i] : 0;
+    }
+
+    return true;
+}
+
+DmabufImportCache::DmabufImportCache(size_t idleLimit)
+    : m_idleLimit(idleLimit)
+{
+}
+
+DmabufImportCache::~DmabufImportCache()
+{
+    clear();
+}
+
+void* DmabufImportCache::acquire(const Key& key)
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return nullptr;
+
+    auto* entry = it->second;
+    if (!entry->refCount++)
+        m_idle.erase(entry->idleLink);
+    return entry->handle;
+}
+
+bool DmabufImportCache::insert(const Key& key, void* handle, const int* fds, DestroyFunction&& destroy)
+{
+    assert(handle);
+    if (m_entries.count(key) || m_handles.count(handle))
+        return false;
+
+    auto* entry = new Entry;
+    entry->key = key;
+    entry->handle = handle;
+    entry->refCount = 1;
+    entry->destroy = std::move(destroy);
+    for (unsigned i = 0; i < key.numPlanes; ++i)
+        entry->fds[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, 0);
+
+    m_entries.insert({ key, entry });
+    m_handles.insert({ handle, entry });
+    return true;
+}
+
+bool DmabufImportCache::release(void* handle)
+{
+    auto it = m_handles.find(handle);
+    if (it == m_handles.end())
+        return false;
+
+    auto* entry = it->second;
+    assert(entry->refCount > 0);
+    if (--entry->refCount)
+        return true;
+
+    if (entry->forgotten) {
+        m_handles.erase(it);
+        destroyEntry(entry);
+        return true;
+    }
+
+    m_idle.push_front(entry);
+    entry->idleLink = m_idle.begin();
+    evictIdleEntries(m_idleLimit);
+    return true;
+}
+
+void DmabufImportCache::forget(const Key& key)
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return;
+
+    auto* entry = it->second;
+    m_entries.erase(it);
+    if (entry->refCount) {
+        // Kept out of m_entries, so a new import of the key gets its own entry.
+        entry->forgotten = true;
+        return;
+    }
+
+    m_idle.erase(entry->idleLink);
+    m_handles.erase(entry->handle);
+    destroyEntry(entry);
+}
+
+void DmabufImportCache::trim()
+{
+    evictIdleEntries(0);
+}
+
+void DmabufImportCache::clear()
+{
+    evictIdleEntries(0);
+
+    // Entries still in use are owned by their users from now on: release()
+    // returns false for them, which makes the caller destroy the handle.
+    for (auto& it : m_handles) {
+        it.second->destroy = nullptr;
+        destroyEntry(it.second);
+    }
+    m_handles.clear();
+    m_entries.clear();
+}
+
+void DmabufImportCache::evictIdleEntries(size_t limit)
+{
+    while (m_idle.size() > limit) {
+        auto* entry = m_idle.back();
+        m_idle.pop_back();
+
+        m_entries.erase(entry->key);
+        m_handles.erase(entry->handle);
+        destroyEntry(entry);
+    }
+}
+
+void DmabufImportCache::destroyEntry(Entry* entry)
+{
+    if (entry->destroy)
+        entry->destroy(entry->handle);
+
+    for (int fd : entry->fds) {
+        if (fd != -1)
+            close(fd);
+    }
+    delete entry;
+}
+
+} // namespace WS
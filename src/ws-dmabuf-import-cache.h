@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace WS {
+
+// Caches imports of dma-buf objects (EGLImages, or opaque handles provided
+// by the embedder) keyed on the kernel identity of the underlying buffers,
+// so that the same dma-buf received again through a new file descriptor is
+// not imported a second time. Entries are reference counted; once unused
+// they are kept around until more than the configured number of idle
+// entries accumulate, at which point the least recently used are destroyed.
+class DmabufImportCache {
+public:
+    struct Key {
+        uint32_t width { 0 };
+        uint32_t height { 0 };
+        uint32_t format { 0 };
+        unsigned numPlanes { 0 };
+
+        struct Plane {
+            dev_t device;
+            ino_t inode;
+            uint32_t offset;
+            uint32_t stride;
+            uint64_t modifier;
+        };
+        std::array<Plane, 4> planes { };
+
+        bool operator==(const Key&) const;
+
+        struct Hash {
+            size_t operator()(const Key&) const;
+        };
+    };
+
+    using DestroyFunction = std::function<void(void*)>;
+
+    // Fills in the key for the given dma-buf planes. Returns false if the
+    // identity cannot be determined reliably (e.g. the kernel places all
+    // dma-bufs on a single shared inode), in which case no caching may be done.
+    static bool computeKey(Key&, uint32_t width, uint32_t height, uint32_t format, unsigned numPlanes,
+        const int* fds, const uint32_t* offsets, const uint32_t* strides, const uint64_t* modifiers);
+
+    explicit DmabufImportCache(size_t idleLimit);
+    ~DmabufImportCache();
+
+    // Returns the handle associated with the key after taking a reference on
+    // it, or nullptr if the key is not in the cache.
+    void* acquire(const Key&);
+
+    // Adds a new handle to the cache with a single reference held. The file
+    // descriptors are duplicated to keep the dma-bufs (and thus their inodes)
+    // alive while the entry is cached. Returns false, leaving the handle owned
+    // by the caller, if the key is already present.
+    bool insert(const Key&, void* handle, const int* fds, DestroyFunction&&);
+
+    // Drops a reference on a cached handle. Returns false if the handle is
+    // not tracked by the cache, in which case the caller keeps ownership.
+    bool release(void* handle);
+
+    // Stops caching the handle for the key, typically because the dma-buf
+    // went away: it is destroyed right away if unused, or once released.
+    void forget(const Key&);
+
+    // Destroys all the entries which are not currently referenced.
+    void trim();
+
+    // Destroys the unused entries and hands the others over to their users,
+    // as release() returns false for them from then on. Meant to be called
+    // while the handles can still be destroyed, before tearing down whatever
+    // they were created with.
+    void clear();
+
+private:
+    struct Entry {
+        Key key;
+        void* handle { nullptr };
+        unsigned refCount { 0 };
+        bool forgotten { false };
+        std::array<int, 4> fds { -1, -1, -1, -1 };
+        DestroyFunction destroy;
+        std::list<Entry*>::iterator idleLink;
+    };
+
+    void destroyEntry(Entry*);
+    void evictIdleEntries(size_t limit);
+
+    size_t m_idleLimit;
+    std::unordered_map<Key, Entry*, Key::Hash> m_entries;
+    std::unordered_map<void*, Entry*> m_handles;
+    // Most recently released entries at the front.
+    std::list<Entry*> m_idle;
+};
+
+} // namespace WS
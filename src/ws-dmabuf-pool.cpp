@@ -51,15 +51,16 @@ void ImplDmabufPool::surfaceCommit(Surface& surface)
         return;
 
     auto* entry = static_cast<struct wpe_dmabuf_pool_entry*>(wl_resource_get_user_data(bufferResource));
+    WS_TRACE_MARK("commitDmabufPoolEntry", surface.bridgeId, surface.frameSequence);
     surface.apiClient->commitDmabufPoolEntry(entry);
 }
 
-struct wpe_dmabuf_pool_entry* ImplDmabufPool::createDmabufPoolEntry(Surface& surface)
+struct wpe_dmabuf_pool_entry* ImplDmabufPool::createDmabufPoolEntry(Surface& surface, uint32_t width, uint32_t height, uint32_t format)
 {
     if (!surface.apiClient)
         return nullptr;
 
-    return surface.apiClient->createDmabufPoolEntry();
+    return surface.apiClient->createDmabufPoolEntry(width, height, format);
 }
 
 bool ImplDmabufPool::initialize()
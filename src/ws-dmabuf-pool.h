@@ -40,7 +40,7 @@ public:
     void surfaceAttach(Surface&, struct wl_resource*) override;
     void surfaceCommit(Surface&) override;
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&) override;
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&, uint32_t width, uint32_t height, uint32_t format) override;
 
     bool initialize();
 
@@ -54,6 +54,10 @@ ImplEGL::ImplEGL()
 
 ImplEGL::~ImplEGL()
 {
+    // Cached images are destroyed while the rest of the object, which their
+    // destroy functions use, is still around.
+    m_importCache.clear();
+
     if (m_dmabuf.global) {
         struct linux_dmabuf_buffer *buffer;
         struct linux_dmabuf_buffer *tmp;
@@ -85,12 +89,16 @@ void ImplEGL::surfaceCommit(Surface& surface)
     struct wl_resource* bufferResource = surface.bufferResource;
     surface.bufferResource = nullptr;
 
-    if (surface.dmabufBuffer)
+    if (surface.dmabufBuffer) {
+        WS_TRACE_MARK("exportLinuxDmabuf", surface.bridgeId, surface.frameSequence);
         surface.apiClient->exportLinuxDmabuf(surface.dmabufBuffer);
-    else if (surface.shmBuffer)
+    } else if (surface.shmBuffer) {
+        WS_TRACE_MARK("exportShmBuffer", surface.bridgeId, surface.frameSequence);
         surface.apiClient->exportShmBuffer(bufferResource, surface.shmBuffer);
-    else
+    } else {
+        WS_TRACE_MARK("exportBufferResource", surface.bridgeId, surface.frameSequence);
         surface.apiClient->exportBufferResource(bufferResource);
+    }
 }
 
 bool ImplEGL::initialize(EGLDisplay eglDisplay)
@@ -160,10 +168,13 @@ EGLImageKHR ImplEGL::createImage(struct wl_resource* resourceBuffer)
         return EGL_NO_IMAGE_KHR;
 
     assert(m_egl.extensions.KHR_image_base);
-    return s_eglCreateImageKHR(m_egl.display, EGL_NO_CONTEXT, EGL_WAYLAND_BUFFER_WL, resourceBuffer, nullptr);
+    EGLImageKHR image = s_eglCreateImageKHR(m_egl.display, EGL_NO_CONTEXT, EGL_WAYLAND_BUFFER_WL, resourceBuffer, nullptr);
+    if (image != EGL_NO_IMAGE_KHR)
+        ++m_liveImageCount;
+    return image;
 }
 
-EGLImageKHR ImplEGL::createImage(const struct linux_dmabuf_buffer* dmabufBuffer)
+EGLImageKHR ImplEGL::createImage(const struct linux_dmabuf_buffer* dmabufBuffer, bool shared)
 {
     static const struct {
         EGLint fd;
@@ -194,6 +205,15 @@ EGLImageKHR ImplEGL::createImage(const struct linux_dmabuf_buffer* dmabufBuffer)
          EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT},
     };
 
+    const auto& attributes = dmabufBuffer->attributes;
+    DmabufImportCache::Key key;
+    bool cacheable = shared && DmabufImportCache::computeKey(key, attributes.width, attributes.height, attributes.format,
+        attributes.n_planes, attributes.fd, attributes.offset, attributes.stride, attributes.modifier);
+    if (cacheable) {
+        if (auto* image = m_importCache.acquire(key))
+            return image;
+    }
+
     EGLint attribs[50];
     int atti = 0;
     attribs[atti++] = EGL_WIDTH;
@@ -219,7 +239,21 @@ EGLImageKHR ImplEGL::createImage(const struct linux_dmabuf_buffer* dmabufBuffer)
     attribs[atti++] = EGL_NONE;
 
     assert(m_egl.extensions.KHR_image_base);
-    return s_eglCreateImageKHR(m_egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+    EGLImageKHR image = s_eglCreateImageKHR(m_egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+    if (image == EGL_NO_IMAGE_KHR)
+        return image;
+
+    ++m_liveImageCount;
+    if (cacheable) {
+        EGLDisplay display = m_egl.display;
+        m_importCache.insert(key, image, attributes.fd,
+            [this, display](void* cachedImage)
+            {
+                s_eglDestroyImageKHR(display, cachedImage);
+                --m_liveImageCount;
+            });
+    }
+    return image;
 }
 
 void ImplEGL::destroyImage(EGLImageKHR image)
@@ -227,8 +261,12 @@ void ImplEGL::destroyImage(EGLImageKHR image)
     if (m_egl.display == EGL_NO_DISPLAY)
         return;
 
+    if (m_importCache.release(image))
+        return;
+
     assert(m_egl.extensions.KHR_image_base);
     s_eglDestroyImageKHR(m_egl.display, image);
+    --m_liveImageCount;
 }
 
 void ImplEGL::queryBufferSize(struct wl_resource* bufferResource, uint32_t* width, uint32_t* height)
@@ -261,6 +299,33 @@ void ImplEGL::importDmaBufBuffer(struct linux_dmabuf_buffer* buffer)
     wl_list_insert(&m_dmabuf.buffers, &buffer->link);
 }
 
+void ImplEGL::dmaBufBufferDestroyed(struct linux_dmabuf_buffer* buffer)
+{
+    const auto& attributes = buffer->attributes;
+    DmabufImportCache::Key key;
+    if (!DmabufImportCache::computeKey(key, attributes.width, attributes.height, attributes.format,
+        attributes.n_planes, attributes.fd, attributes.offset, attributes.stride, attributes.modifier))
+        return;
+
+    // The image stays cached while other wl_buffers wrap the same dma-buf,
+    // and is dropped along with the last one, so that the cache does not keep
+    // the memory of buffers the client is done with.
+    struct linux_dmabuf_buffer* other;
+    wl_list_for_each(other, &m_dmabuf.buffers, link) {
+        if (other == buffer || other->attributes.n_planes != attributes.n_planes)
+            continue;
+
+        DmabufImportCache::Key otherKey;
+        const auto& otherAttributes = other->attributes;
+        if (DmabufImportCache::computeKey(otherKey, otherAttributes.width, otherAttributes.height, otherAttributes.format,
+            otherAttributes.n_planes, otherAttributes.fd, otherAttributes.offset, otherAttributes.stride, otherAttributes.modifier)
+            && otherKey == key)
+            return;
+    }
+
+    m_importCache.forget(key);
+}
+
 const struct linux_dmabuf_buffer* ImplEGL::getDmaBufBuffer(struct wl_resource* bufferResource) const
 {
     if (!m_dmabuf.global || !bufferResource)
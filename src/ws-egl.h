@@ -26,6 +26,7 @@
 #pragma once
 
 #include "ws.h"
+#include "ws-dmabuf-import-cache.h"
 #include <functional>
 
 typedef void *EGLDisplay;
@@ -44,16 +45,22 @@ public:
     void surfaceAttach(Surface&, struct wl_resource*) override;
     void surfaceCommit(Surface&) override;
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&) override { return nullptr; }
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&, uint32_t, uint32_t, uint32_t) override { return nullptr; }
+
+    void trimMemory(TrimMemoryLevel) override { m_importCache.trim(); }
 
     bool initialize(EGLDisplay);
 
     EGLImageKHR createImage(struct wl_resource*);
-    EGLImageKHR createImage(const struct linux_dmabuf_buffer*);
+    // Images for the same dma-buf are shared through the import cache, unless
+    // the caller needs one image per buffer to tell them apart.
+    EGLImageKHR createImage(const struct linux_dmabuf_buffer*, bool shared = true);
     void destroyImage(EGLImageKHR);
     void queryBufferSize(struct wl_resource*, uint32_t* width, uint32_t* height);
+    unsigned liveImageCount() const { return m_liveImageCount; }
 
     void importDmaBufBuffer(struct linux_dmabuf_buffer*);
+    void dmaBufBufferDestroyed(struct linux_dmabuf_buffer*);
     const struct linux_dmabuf_buffer* getDmaBufBuffer(struct wl_resource*) const;
     void foreachDmaBufModifier(std::function<void (int format, uint64_t modifier)>);
 
@@ -75,6 +82,16 @@ private:
         struct wl_global* global { nullptr };
         struct wl_list buffers;
     } m_dmabuf;
+
+    unsigned m_liveImageCount { 0 };
+
+    // EGLImages created from dma-bufs, shared among all the wl_buffers which
+    // wrap the same underlying buffers. Idle images are those of buffers the
+    // client still has but is not presenting; the limit lets the swapchains
+    // of a few views (three or four buffers each) cycle without importing
+    // again, while bounding the images kept for views which stopped rendering.
+    static const size_t s_idleImageLimit = 16;
+    DmabufImportCache m_importCache { s_idleImageLimit };
 };
 
 template<>
@@ -79,6 +79,7 @@ void ImplEGLStream::surfaceCommit(Surface& surface)
     struct wl_resource* bufferResource = surface.bufferResource;
     surface.bufferResource = nullptr;
 
+    WS_TRACE_MARK("exportBufferResource", surface.bridgeId, surface.frameSequence);
     surface.apiClient->exportBufferResource(bufferResource);
 }
 
@@ -42,7 +42,7 @@ public:
     void surfaceAttach(Surface&, struct wl_resource*) override;
     void surfaceCommit(Surface&) override;
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&) override { return nullptr; }
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&, uint32_t, uint32_t, uint32_t) override { return nullptr; }
 
     bool initialize(EGLDisplay);
 
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ws-region.h"
+
+namespace WS {
+
+void Region::add(const Rect& rect)
+{
+    if (rect.isEmpty())
+        return;
+
+    subtract(rect);
+    m_rects.push_back(rect);
+}
+
+void Region::subtract(const Rect& rect)
+{
+    if (rect.isEmpty())
+        return;
+
+    int32_t x2 = rect.x + rect.width;
+    int32_t y2 = rect.y + rect.height;
+
+    std::vector<Rect> rects;
+    rects.reserve(m_rects.size());
+    for (auto& r : m_rects) {
+        int32_t rx2 = r.x + r.width;
+        int32_t ry2 = r.y + r.height;
+        if (rect.x >= rx2 || x2 <= r.x || rect.y >= ry2 || y2 <= r.y) {
+            rects.push_back(r);
+            continue;
+        }
+
+        // Keep the parts above and below the subtracted rectangle at full
+        // width, and those to the left and right of it in between.
+        int32_t top = std::max(r.y, rect.y);
+        int32_t bottom = std::min(ry2, y2);
+        if (r.y < rect.y)
+            rects.push_back({ r.x, r.y, r.width, rect.y - r.y });
+        if (ry2 > y2)
+            rects.push_back({ r.x, y2, r.width, ry2 - y2 });
+        if (r.x < rect.x)
+            rects.push_back({ r.x, top, rect.x - r.x, bottom - top });
+        if (rx2 > x2)
+            rects.push_back({ x2, top, rx2 - x2, bottom - top });
+    }
+    m_rects = std::move(rects);
+}
+
+} // namespace WS
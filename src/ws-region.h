@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace WS {
+
+struct Rect {
+    int32_t x { 0 };
+    int32_t y { 0 };
+    int32_t width { 0 };
+    int32_t height { 0 };
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+
+    // Grows the rectangle to the bounding box of both.
+    void unite(const Rect& other)
+    {
+        if (other.isEmpty())
+            return;
+        if (isEmpty()) {
+            *this = other;
+            return;
+        }
+
+        int32_t x2 = std::max(x + width, other.x + other.width);
+        int32_t y2 = std::max(y + height, other.y + other.height);
+        x = std::min(x, other.x);
+        y = std::min(y, other.y);
+        width = x2 - x;
+        height = y2 - y;
+    }
+};
+
+// Area made of non-overlapping rectangles, as built through wl_region.
+class Region {
+public:
+    const std::vector<Rect>& rects() const { return m_rects; }
+    bool isEmpty() const { return m_rects.empty(); }
+
+    void add(const Rect&);
+    void subtract(const Rect&);
+    void clear() { m_rects.clear(); }
+
+private:
+    std::vector<Rect> m_rects;
+};
+
+} // namespace WS
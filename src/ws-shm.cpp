@@ -25,10 +25,152 @@
 
 #include "ws-shm.h"
 
+#include "../include/wpe/exported-buffer-shm.h"
+#include "linux-dmabuf/drm_fourcc.h"
+#include <fcntl.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
 namespace WS {
 
-ImplSHM::ImplSHM() = default;
-ImplSHM::~ImplSHM() = default;
+struct ImplSHM::Pool {
+    ~Pool()
+    {
+        invalidateDmabuf();
+        if (fd != -1)
+            close(fd);
+    }
+
+    void invalidateDmabuf()
+    {
+        if (dmabufFD != -1)
+            close(dmabufFD);
+        dmabufFD = -1;
+        dmabufSize = 0;
+        dmabufFailed = false;
+    }
+
+    bool isSealed() const
+    {
+        int seals = fcntl(fd, F_GET_SEALS);
+        return seals != -1 && (seals & F_SEAL_SHRINK);
+    }
+
+    int fd { -1 };
+    int32_t size { 0 };
+
+    // Mapping of the whole pool, replaced after a resize. Exported buffers
+    // keep a reference on the mapping they point into.
+    std::shared_ptr<const void> mapping;
+    size_t mappingSize { 0 };
+
+    // Created on first use, and again after the pool is resized.
+    int dmabufFD { -1 };
+    size_t dmabufSize { 0 };
+    bool dmabufFailed { false };
+};
+
+struct ImplSHM::PoolResource {
+    std::shared_ptr<Pool> pool;
+    struct wl_listener destroyListener;
+
+    static void destroyNotify(struct wl_listener* listener, void*)
+    {
+        PoolResource* resource;
+        resource = wl_container_of(listener, resource, destroyListener);
+        delete resource;
+    }
+
+    static PoolResource* find(struct wl_resource* resource)
+    {
+        if (auto* listener = wl_resource_get_destroy_listener(resource, destroyNotify)) {
+            PoolResource* poolResource;
+            return wl_container_of(listener, poolResource, destroyListener);
+        }
+        return nullptr;
+    }
+};
+
+// Buffers keep a reference on their pool, as its memory outlives the
+// wl_shm_pool object until all the buffers created from it are gone.
+struct ImplSHM::BufferResource {
+    std::shared_ptr<Pool> pool;
+    int32_t offset;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t format;
+    struct wl_listener destroyListener;
+
+    static void destroyNotify(struct wl_listener* listener, void*)
+    {
+        BufferResource* resource;
+        resource = wl_container_of(listener, resource, destroyListener);
+        delete resource;
+    }
+
+    static BufferResource* find(struct wl_resource* resource)
+    {
+        if (auto* listener = wl_resource_get_destroy_listener(resource, destroyNotify)) {
+            BufferResource* bufferResource;
+            return wl_container_of(listener, bufferResource, destroyListener);
+        }
+        return nullptr;
+    }
+};
+
+struct ImplSHM::ClientListener {
+    ImplSHM* impl;
+    struct wl_list link;
+    struct wl_listener resourceCreatedListener;
+    struct wl_listener destroyListener;
+
+    static void resourceCreated(struct wl_listener* listener, void* data)
+    {
+        ClientListener* clientListener;
+        clientListener = wl_container_of(listener, clientListener, resourceCreatedListener);
+        clientListener->impl->resourceCreated(static_cast<struct wl_resource*>(data));
+    }
+
+    static void destroy(struct wl_listener* listener, void*)
+    {
+        ClientListener* clientListener;
+        clientListener = wl_container_of(listener, clientListener, destroyListener);
+        clientListener->remove();
+        delete clientListener;
+    }
+
+    void remove()
+    {
+        wl_list_remove(&link);
+        wl_list_remove(&resourceCreatedListener.link);
+        wl_list_remove(&destroyListener.link);
+    }
+};
+
+ImplSHM::ImplSHM()
+{
+    wl_list_init(&m_pools.clients);
+    m_pools.clientCreated.impl = this;
+    wl_list_init(&m_pools.clientCreated.listener.link);
+}
+
+ImplSHM::~ImplSHM()
+{
+    ClientListener* clientListener;
+    ClientListener* next;
+    wl_list_for_each_safe(clientListener, next, &m_pools.clients, link) {
+        clientListener->remove();
+        delete clientListener;
+    }
+    wl_list_remove(&m_pools.clientCreated.listener.link);
+
+    if (m_pools.logger)
+        wl_protocol_logger_destroy(m_pools.logger);
+    if (m_udmabufFD != -1)
+        close(m_udmabufFD);
+}
 
 void ImplSHM::surfaceAttach(Surface& surface, struct wl_resource* bufferResource)
 {
@@ -47,20 +189,253 @@ void ImplSHM::surfaceCommit(Surface& surface)
     struct wl_resource* bufferResource = surface.bufferResource;
     surface.bufferResource = nullptr;
 
-    if (surface.shmBuffer)
+    if (surface.shmBuffer) {
+        WS_TRACE_MARK("exportShmBuffer", surface.bridgeId, surface.frameSequence);
         surface.apiClient->exportShmBuffer(bufferResource, surface.shmBuffer);
-    else
+    } else {
+        WS_TRACE_MARK("exportBufferResource", surface.bridgeId, surface.frameSequence);
         surface.apiClient->exportBufferResource(bufferResource);
+    }
 }
 
-bool ImplSHM::initialize()
+bool ImplSHM::initialize(bool useUdmabuf)
 {
     // wl_display_init_shm() returns `0` on success.
     if (wl_display_init_shm(display()) != 0)
         return false;
 
+    // ARGB8888 and XRGB8888 are always advertised; 16bpp lets clients halve
+    // upload and composition bandwidth for content without alpha.
+    if (!wl_display_add_shm_format(display(), WL_SHM_FORMAT_RGB565))
+        return false;
+
+    if (!m_pools.logger) {
+        m_pools.logger = wl_display_add_protocol_logger(display(), logRequest, this);
+        m_pools.clientCreated.listener.notify = [](struct wl_listener* listener, void* data)
+        {
+            decltype(m_pools.clientCreated)* clientCreated;
+            clientCreated = wl_container_of(listener, clientCreated, listener);
+            ImplSHM* impl = clientCreated->impl;
+
+            auto* clientListener = new ClientListener;
+            clientListener->impl = impl;
+            clientListener->resourceCreatedListener.notify = ClientListener::resourceCreated;
+            clientListener->destroyListener.notify = ClientListener::destroy;
+
+            auto* client = static_cast<struct wl_client*>(data);
+            wl_client_add_resource_created_listener(client, &clientListener->resourceCreatedListener);
+            wl_client_add_destroy_listener(client, &clientListener->destroyListener);
+            wl_list_insert(&impl->m_pools.clients, &clientListener->link);
+        };
+        wl_display_add_client_created_listener(display(), &m_pools.clientCreated.listener);
+    }
+
+    if (useUdmabuf && m_udmabufFD == -1) {
+        m_udmabufFD = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+        if (m_udmabufFD == -1)
+            g_warning("Cannot open /dev/udmabuf, shm buffers will not be exported as dma-bufs");
+    }
+
     m_initialized = true;
     return true;
 }
 
+bool ImplSHM::exportDmabuf(struct wl_resource* bufferResource, struct wpe_fdo_shm_dmabuf_attributes& attributes)
+{
+    if (m_udmabufFD == -1 || !bufferResource)
+        return false;
+
+    auto* buffer = BufferResource::find(bufferResource);
+    if (!buffer)
+        return false;
+
+    auto& pool = *buffer->pool;
+    if (pool.dmabufFD == -1 && !pool.dmabufFailed)
+        createDmabuf(pool);
+    if (pool.dmabufFD == -1)
+        return false;
+
+    if (uint64_t(buffer->offset) + uint64_t(buffer->stride) * buffer->height > pool.dmabufSize)
+        return false;
+
+    int fd = fcntl(pool.dmabufFD, F_DUPFD_CLOEXEC, 0);
+    if (fd == -1)
+        return false;
+
+    attributes.fd = fd;
+    attributes.width = buffer->width;
+    attributes.height = buffer->height;
+    // Apart from these two, wl_shm formats use the DRM fourcc codes.
+    switch (buffer->format) {
+    case WL_SHM_FORMAT_ARGB8888:
+        attributes.format = DRM_FORMAT_ARGB8888;
+        break;
+    case WL_SHM_FORMAT_XRGB8888:
+        attributes.format = DRM_FORMAT_XRGB8888;
+        break;
+    default:
+        attributes.format = buffer->format;
+        break;
+    }
+    attributes.offset = buffer->offset;
+    attributes.stride = buffer->stride;
+    attributes.modifier = DRM_FORMAT_MOD_LINEAR;
+    return true;
+}
+
+std::shared_ptr<const void> ImplSHM::sealedMapping(struct wl_resource* bufferResource, size_t& offset)
+{
+    auto* buffer = bufferResource ? BufferResource::find(bufferResource) : nullptr;
+    if (!buffer)
+        return nullptr;
+
+    auto& pool = *buffer->pool;
+    if (!pool.mapping) {
+        if (pool.size <= 0 || !pool.isSealed())
+            return nullptr;
+
+        size_t size = pool.size;
+        void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, pool.fd, 0);
+        if (data == MAP_FAILED)
+            return nullptr;
+
+        pool.mapping = std::shared_ptr<const void>(data,
+            [size](const void* data)
+            {
+                munmap(const_cast<void*>(data), size);
+            });
+        pool.mappingSize = size;
+    }
+
+    if (uint64_t(buffer->offset) + uint64_t(buffer->stride) * buffer->height > pool.mappingSize)
+        return nullptr;
+
+    offset = buffer->offset;
+    return pool.mapping;
+}
+
+void ImplSHM::createDmabuf(Pool& pool)
+{
+    // Not retried until the pool is resized.
+    pool.dmabufFailed = true;
+
+    // udmabuf pins the pages of the memfd, so it must not be able to shrink.
+    int seals = fcntl(pool.fd, F_GET_SEALS);
+    if (seals == -1 || !(seals & F_SEAL_SHRINK) || (seals & F_SEAL_WRITE))
+        return;
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = size_t(pool.size) & ~(pageSize - 1);
+    if (!size)
+        return;
+
+    struct udmabuf_create create = { };
+    create.memfd = pool.fd;
+    create.flags = UDMABUF_FLAGS_CLOEXEC;
+    create.offset = 0;
+    create.size = size;
+
+    int fd = ioctl(m_udmabufFD, UDMABUF_CREATE, &create);
+    if (fd < 0)
+        return;
+
+    pool.dmabufFD = fd;
+    pool.dmabufSize = size;
+    pool.dmabufFailed = false;
+}
+
+void ImplSHM::logRequest(void* data, enum wl_protocol_logger_type type, const struct wl_protocol_logger_message* message)
+{
+    if (type != WL_PROTOCOL_LOGGER_REQUEST)
+        return;
+
+    // This runs for every request of every client: requests are told apart by
+    // their description, which points into the interface they belong to.
+    static const struct wl_message* const s_shmCreatePool = &wl_shm_interface.methods[0];
+    static const struct wl_message* const s_shmPoolCreateBuffer = &wl_shm_pool_interface.methods[0];
+    static const struct wl_message* const s_shmPoolResize = &wl_shm_pool_interface.methods[2];
+
+    auto& impl = *static_cast<ImplSHM*>(data);
+    auto& pending = impl.m_pools.pending;
+
+    // Resources are created while the request is dispatched, so whatever is
+    // pending from a previous request is stale by now.
+    if (pending.pool)
+        pending = { };
+
+    if (message->message == s_shmCreatePool) {
+        // Both the udmabuf wrapping and the sealed mapping need the memory
+        // to be sealed against shrinking, other pools are not tracked.
+        int seals = fcntl(message->arguments[1].h, F_GET_SEALS);
+        if (seals == -1 || !(seals & F_SEAL_SHRINK))
+            return;
+
+        int fd = fcntl(message->arguments[1].h, F_DUPFD_CLOEXEC, 0);
+        if (fd == -1)
+            return;
+
+        pending.pool = std::make_shared<Pool>();
+        pending.pool->fd = fd;
+        pending.pool->size = message->arguments[2].i;
+        pending.client = wl_resource_get_client(message->resource);
+        pending.id = message->arguments[0].n;
+        return;
+    }
+
+    if (message->message != s_shmPoolCreateBuffer && message->message != s_shmPoolResize)
+        return;
+
+    auto* poolResource = PoolResource::find(message->resource);
+    if (!poolResource)
+        return;
+
+    if (message->message == s_shmPoolCreateBuffer) {
+        pending.pool = poolResource->pool;
+        pending.client = wl_resource_get_client(message->resource);
+        pending.id = message->arguments[0].n;
+        pending.isBuffer = true;
+        pending.offset = message->arguments[1].i;
+        pending.width = message->arguments[2].i;
+        pending.height = message->arguments[3].i;
+        pending.stride = message->arguments[4].i;
+        pending.format = message->arguments[5].u;
+        return;
+    }
+
+    // Pools can only grow, libwayland-server rejects the request otherwise.
+    int32_t size = message->arguments[0].i;
+    if (size <= poolResource->pool->size)
+        return;
+
+    poolResource->pool->size = size;
+    poolResource->pool->invalidateDmabuf();
+    poolResource->pool->mapping = nullptr;
+}
+
+void ImplSHM::resourceCreated(struct wl_resource* resource)
+{
+    auto& pending = m_pools.pending;
+    if (!pending.pool || wl_resource_get_client(resource) != pending.client || wl_resource_get_id(resource) != pending.id)
+        return;
+
+    if (pending.isBuffer) {
+        auto* buffer = new BufferResource;
+        buffer->pool = std::move(pending.pool);
+        buffer->offset = pending.offset;
+        buffer->width = pending.width;
+        buffer->height = pending.height;
+        buffer->stride = pending.stride;
+        buffer->format = pending.format;
+        buffer->destroyListener.notify = BufferResource::destroyNotify;
+        wl_resource_add_destroy_listener(resource, &buffer->destroyListener);
+    } else {
+        auto* pool = new PoolResource;
+        pool->pool = std::move(pending.pool);
+        pool->destroyListener.notify = PoolResource::destroyNotify;
+        wl_resource_add_destroy_listener(resource, &pool->destroyListener);
+    }
+
+    pending = { };
+}
+
 } // namespace WS
@@ -26,6 +26,9 @@
 #pragma once
 
 #include "ws.h"
+#include <memory>
+
+struct wpe_fdo_shm_dmabuf_attributes;
 
 namespace WS {
 
@@ -40,12 +43,60 @@ public:
     void surfaceAttach(Surface&, struct wl_resource*) override;
     void surfaceCommit(Surface&) override;
 
-    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&) override { return nullptr; }
+    struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&, uint32_t, uint32_t, uint32_t) override { return nullptr; }
+
+    // With useUdmabuf set, the memory of shm pools backed by memfds is also
+    // wrapped into dma-bufs through /dev/udmabuf, when available.
+    bool initialize(bool useUdmabuf = false);
 
-    bool initialize();
+    // Fills in the dma-buf attributes of a shm buffer, the caller taking
+    // ownership of the file descriptor. Returns false if the buffer memory
+    // cannot be wrapped, e.g. when it is not a memfd sealed against shrinking.
+    bool exportDmabuf(struct wl_resource*, struct wpe_fdo_shm_dmabuf_attributes&);
+
+    // Returns a read-only mapping of the pool of a shm buffer, and the offset
+    // of the buffer in it. The mapping is only provided when the pool memory
+    // is sealed against shrinking, so accessing it cannot raise SIGBUS.
+    std::shared_ptr<const void> sealedMapping(struct wl_resource*, size_t& offset);
 
 private:
+    struct Pool;
+    struct PoolResource;
+    struct BufferResource;
+    struct ClientListener;
+
+    static void logRequest(void*, enum wl_protocol_logger_type, const struct wl_protocol_logger_message*);
+    void resourceCreated(struct wl_resource*);
+    void createDmabuf(Pool&);
+
     bool m_initialized { false };
+
+    int m_udmabufFD { -1 };
+
+    // libwayland-server does not expose the file descriptors of shm pools,
+    // so the requests creating pools and buffers are observed through a
+    // protocol logger and matched with the resources they create. Only pools
+    // sealed against shrinking are tracked, as nothing else can use them.
+    struct {
+        struct wl_protocol_logger* logger { nullptr };
+        struct wl_list clients;
+        struct {
+            ImplSHM* impl;
+            struct wl_listener listener;
+        } clientCreated;
+
+        struct {
+            struct wl_client* client { nullptr };
+            uint32_t id { 0 };
+            bool isBuffer { false };
+            std::shared_ptr<Pool> pool;
+            int32_t offset { 0 };
+            int32_t width { 0 };
+            int32_t height { 0 };
+            int32_t stride { 0 };
+            uint32_t format { 0 };
+        } pending;
+    } m_pools;
 };
 
 } // namespace WS
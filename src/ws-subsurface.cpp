@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ws-subsurface.h"
+
+#include <algorithm>
+
+namespace WS {
+
+BufferReference::BufferReference()
+{
+    m_destroyListener.notify = destroyNotify;
+    wl_list_init(&m_destroyListener.link);
+}
+
+BufferReference::~BufferReference()
+{
+    wl_list_remove(&m_destroyListener.link);
+}
+
+void BufferReference::set(struct wl_resource* resource)
+{
+    if (resource == m_resource)
+        return;
+
+    wl_list_remove(&m_destroyListener.link);
+    wl_list_init(&m_destroyListener.link);
+
+    m_resource = resource;
+    if (m_resource)
+        wl_resource_add_destroy_listener(m_resource, &m_destroyListener);
+}
+
+void BufferReference::release()
+{
+    if (!m_resource)
+        return;
+
+    wl_buffer_send_release(m_resource);
+    set(nullptr);
+}
+
+void BufferReference::destroyNotify(struct wl_listener* listener, void*)
+{
+    BufferReference* reference;
+    reference = wl_container_of(listener, reference, m_destroyListener);
+
+    wl_list_remove(&reference->m_destroyListener.link);
+    wl_list_init(&reference->m_destroyListener.link);
+    reference->m_resource = nullptr;
+}
+
+static void removeFromStack(std::vector<Surface*>& stack, Surface* surface)
+{
+    stack.erase(std::remove(stack.begin(), stack.end(), surface), stack.end());
+}
+
+Subsurface::Subsurface(struct wl_resource* subsurfaceResource, Surface& surface, Surface& parent)
+    : resource(subsurfaceResource)
+    , surface(&surface)
+    , parent(&parent)
+{
+    surface.subsurface = this;
+    parent.pendingStack.push_back(&surface);
+}
+
+Subsurface::~Subsurface()
+{
+    if (parent) {
+        removeFromStack(parent->pendingStack, surface);
+        removeFromStack(parent->stack, surface);
+    }
+    surface->subsurface = nullptr;
+
+    current.buffer.release();
+    cached.buffer.release();
+    releaseRetiredBuffers();
+}
+
+Surface& Subsurface::root()
+{
+    Surface* root = surface;
+    while (root->subsurface && root->subsurface->parent)
+        root = root->subsurface->parent;
+    return *root;
+}
+
+bool Subsurface::isSynchronized() const
+{
+    for (const Subsurface* subsurface = this; subsurface; subsurface = subsurface->parent ? subsurface->parent->subsurface : nullptr) {
+        if (subsurface->synchronized)
+            return true;
+    }
+    return false;
+}
+
+void Subsurface::commit()
+{
+    if (surface->bufferAttached) {
+        // A buffer which was cached but never applied is not used anymore.
+        if (cached.buffer.resource() != surface->bufferResource)
+            cached.buffer.release();
+
+        cached.buffer.set(surface->bufferResource);
+        cached.dmabufBuffer = surface->bufferResource ? surface->dmabufBuffer : nullptr;
+        cachedBufferAttached = true;
+
+        surface->bufferResource = nullptr;
+        surface->bufferAttached = false;
+    }
+
+    cached.damage.unite(surface->pendingDamage);
+    surface->pendingDamage = { };
+    hasCachedState = true;
+
+    if (isSynchronized())
+        return;
+
+    applyCachedState();
+
+    Surface& rootSurface = root();
+    if (rootSurface.apiClient)
+        rootSurface.apiClient->layersChanged(rootSurface);
+}
+
+void Subsurface::applyCachedState()
+{
+    if (cachedBufferAttached) {
+        struct wl_resource* replacedBuffer = current.buffer.resource();
+        if (replacedBuffer && replacedBuffer != cached.buffer.resource()) {
+            // The embedder may still be presenting any buffer replaced since
+            // the last complete frame, keep them all until the next one.
+            auto isReplaced = [replacedBuffer](const BufferReference& buffer) { return buffer.resource() == replacedBuffer; };
+            if (std::none_of(retiredBuffers.begin(), retiredBuffers.end(), isReplaced)) {
+                retiredBuffers.emplace_back();
+                retiredBuffers.back().set(replacedBuffer);
+            }
+        }
+
+        // A retired buffer which is attached again is in use once more.
+        if (struct wl_resource* attachedBuffer = cached.buffer.resource())
+            retiredBuffers.remove_if([attachedBuffer](const BufferReference& buffer) { return buffer.resource() == attachedBuffer; });
+
+        current.buffer.set(cached.buffer.resource());
+        current.dmabufBuffer = cached.dmabufBuffer;
+        cached.buffer.set(nullptr);
+        cached.dmabufBuffer = nullptr;
+        cachedBufferAttached = false;
+    }
+
+    current.damage.unite(cached.damage);
+    cached.damage = { };
+    hasCachedState = false;
+
+    applyChildrenState(*surface);
+}
+
+void Subsurface::applyChildrenState(Surface& parent)
+{
+    parent.stack = parent.pendingStack;
+
+    for (auto* child : parent.stack) {
+        if (child == &parent)
+            continue;
+
+        auto& subsurface = *child->subsurface;
+        subsurface.position = subsurface.pendingPosition;
+        if (subsurface.hasCachedState && subsurface.isSynchronized())
+            subsurface.applyCachedState();
+    }
+}
+
+static bool restack(Subsurface& subsurface, Surface& sibling, bool above)
+{
+    auto& stack = subsurface.parent->pendingStack;
+    if (&sibling == subsurface.surface || std::find(stack.begin(), stack.end(), &sibling) == stack.end())
+        return false;
+
+    removeFromStack(stack, subsurface.surface);
+    auto it = std::find(stack.begin(), stack.end(), &sibling);
+    stack.insert(above ? it + 1 : it, subsurface.surface);
+    return true;
+}
+
+bool Subsurface::placeAbove(Subsurface& subsurface, Surface& sibling)
+{
+    return restack(subsurface, sibling, true);
+}
+
+bool Subsurface::placeBelow(Subsurface& subsurface, Surface& sibling)
+{
+    return restack(subsurface, sibling, false);
+}
+
+void Subsurface::releaseRetiredBuffers(Surface& surface)
+{
+    for (auto* child : surface.stack) {
+        if (child == &surface)
+            continue;
+
+        child->subsurface->releaseRetiredBuffers();
+        releaseRetiredBuffers(*child);
+    }
+}
+
+void Subsurface::releaseRetiredBuffers()
+{
+    for (auto& buffer : retiredBuffers)
+        buffer.release();
+    retiredBuffers.clear();
+}
+
+void Subsurface::surfaceDestroyed(Surface& surface)
+{
+    // Sub-surfaces of the surface lose their role, and become inert.
+    std::vector<Surface*> children;
+    for (auto* child : surface.pendingStack) {
+        if (child != &surface)
+            children.push_back(child);
+    }
+    for (auto* child : surface.stack) {
+        if (child != &surface && std::find(children.begin(), children.end(), child) == children.end())
+            children.push_back(child);
+    }
+
+    for (auto* child : children) {
+        Subsurface* subsurface = child->subsurface;
+        wl_resource_set_user_data(subsurface->resource, nullptr);
+        delete subsurface;
+    }
+
+    if (surface.subsurface) {
+        Subsurface* subsurface = surface.subsurface;
+        Surface* rootSurface = subsurface->parent ? &subsurface->root() : nullptr;
+
+        wl_resource_set_user_data(subsurface->resource, nullptr);
+        delete subsurface;
+
+        if (rootSurface && rootSurface->apiClient)
+            rootSurface->apiClient->layersChanged(*rootSurface);
+    }
+}
+
+static void collectLayers(Surface& surface, int32_t x, int32_t y, std::vector<Layer>& layers, int32_t& rootIndex)
+{
+    for (auto* entry : surface.stack) {
+        if (entry == &surface) {
+            if (!surface.subsurface) {
+                rootIndex = layers.size();
+                continue;
+            }
+
+            auto& current = surface.subsurface->current;
+            Layer layer;
+            layer.bufferResource = current.buffer.resource();
+            layer.dmabufBuffer = current.dmabufBuffer;
+            layer.x = x;
+            layer.y = y;
+            layer.zOrder = layers.size();
+            layer.damage = current.damage;
+            current.damage = { };
+            layers.push_back(layer);
+            continue;
+        }
+
+        // Sub-surfaces without a buffer are unmapped, along with their children.
+        auto& subsurface = *entry->subsurface;
+        if (!subsurface.current.buffer.resource())
+            continue;
+
+        collectLayers(*entry, x + subsurface.position.x, y + subsurface.position.y, layers, rootIndex);
+    }
+}
+
+void collectLayers(Surface& root, std::vector<Layer>& layers)
+{
+    int32_t rootIndex = 0;
+    collectLayers(root, 0, 0, layers, rootIndex);
+
+    // The root surface takes the place of index rootIndex in the stack.
+    for (auto& layer : layers)
+        layer.zOrder = layer.zOrder < rootIndex ? layer.zOrder - rootIndex : layer.zOrder - rootIndex + 1;
+}
+
+} // namespace WS
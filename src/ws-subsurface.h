@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "ws.h"
+#include <list>
+#include <vector>
+
+struct linux_dmabuf_buffer;
+
+namespace WS {
+
+// Tracks a wl_buffer which the client may destroy at any time.
+class BufferReference {
+public:
+    BufferReference();
+    ~BufferReference();
+
+    BufferReference(const BufferReference&) = delete;
+    BufferReference& operator=(const BufferReference&) = delete;
+
+    struct wl_resource* resource() const { return m_resource; }
+    void set(struct wl_resource*);
+
+    // Sends wl_buffer.release, then drops the reference.
+    void release();
+
+private:
+    static void destroyNotify(struct wl_listener*, void*);
+
+    struct wl_resource* m_resource { nullptr };
+    struct wl_listener m_destroyListener;
+};
+
+// wl_subsurface role of a Surface. Sub-surfaces are not exported on their own:
+// their buffers are presented to the embedder as layers of the view which
+// owns the root of the surface tree.
+struct Subsurface {
+    Subsurface(struct wl_resource*, Surface&, Surface& parent);
+    ~Subsurface();
+
+    Surface& root();
+    bool isSynchronized() const;
+
+    // wl_surface.commit on the sub-surface.
+    void commit();
+    // Makes the cached state current, as when the sub-surface is desynchronized.
+    void applyCachedState();
+    // Applies the cached state of synchronized sub-surfaces below a surface
+    // which has just been committed, along with their position and stacking.
+    static void applyChildrenState(Surface&);
+
+    // Both return false if the sibling is neither the parent nor one of its
+    // sub-surfaces.
+    static bool placeAbove(Subsurface&, Surface& sibling);
+    static bool placeBelow(Subsurface&, Surface& sibling);
+
+    // Invoked when the embedder is done with a frame: buffers replaced since
+    // then can be handed back to the client.
+    static void releaseRetiredBuffers(Surface&);
+    void releaseRetiredBuffers();
+
+    // Detaches the sub-surfaces of a surface which is being destroyed, and
+    // removes the surface from the stack of its parent.
+    static void surfaceDestroyed(Surface&);
+
+    struct State {
+        BufferReference buffer;
+        const struct linux_dmabuf_buffer* dmabufBuffer { nullptr };
+        Rect damage;
+    };
+
+    struct wl_resource* resource;
+    Surface* surface;
+    Surface* parent;
+
+    bool synchronized { true };
+    struct {
+        int32_t x { 0 };
+        int32_t y { 0 };
+    } pendingPosition, position;
+
+    bool hasCachedState { false };
+    bool cachedBufferAttached { false };
+    State cached;
+    State current;
+    // Buffers replaced since the last complete frame.
+    std::list<BufferReference> retiredBuffers;
+};
+
+struct Layer {
+    struct wl_resource* bufferResource;
+    const struct linux_dmabuf_buffer* dmabufBuffer;
+    int32_t x;
+    int32_t y;
+    // Position in the stack relative to the root surface, which sits at 0:
+    // negative below it, positive above.
+    int32_t zOrder;
+    Rect damage;
+};
+
+// Collects the mapped sub-surfaces under a root surface, bottom to top. The
+// damage of the collected layers is reset.
+void collectLayers(Surface& root, std::vector<Layer>&);
+
+} // namespace WS
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Igalia S.L.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Trace marks along the lifecycle of a frame, on both the client and the
+// host side. Each mark carries the wpe_bridge identifier of the surface and
+// a frame sequence number, which counts commits on the surface in both
+// processes, so that marks for the same frame can be matched.
+//
+// Marks are only compiled in when building with -Dtracing=true, and are
+// recorded using sysprof-capture (e.g. with "sysprof-cli --", or by running
+// under Sysprof).
+
+#if defined(WPE_FDO_TRACING) && WPE_FDO_TRACING
+
+#include <cinttypes>
+#include <sysprof-capture.h>
+
+#define WS_TRACE_MARK(name, bridgeId, frame) \
+    sysprof_collector_mark_printf(SYSPROF_CAPTURE_CURRENT_TIME, 0, "WPEBackend-fdo", name, \
+        "bridge=%" PRIu32 " frame=%" PRIu64, static_cast<uint32_t>(bridgeId), static_cast<uint64_t>(frame))
+
+#else
+
+#define WS_TRACE_MARK(name, bridgeId, frame) do { } while (0)
+
+#endif
@@ -38,6 +38,12 @@ enum class ClientImplementationType {
     Invalid,
     DmabufPool,
     Wayland,
+    SHM,
+};
+
+enum class TrimMemoryLevel {
+    Moderate,
+    Critical,
 };
 
 } // namespace WS
@@ -26,17 +26,31 @@
 #include "ws.h"
 
 #include "dmabuf-pool-entry-private.h"
+#include "ws-subsurface.h"
+#include "linux-dmabuf/linux-dmabuf.h"
+#include "linux-explicit-synchronization-unstable-v1-server-protocol.h"
+#include "viewporter-server-protocol.h"
 #include "wpe-audio-server-protocol.h"
 #include "wpe-bridge-server-protocol.h"
 #include "wpe-dmabuf-pool-server-protocol.h"
 #include "wpe-video-plane-display-dmabuf-server-protocol.h"
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <linux/sync_file.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 struct wpe_video_plane_display_dmabuf_export {
     struct wl_resource* updateResource;
+
+    bool cacheable { false };
+    WS::DmabufImportCache::Key key;
+    int fd { -1 };
+
+    void* import { nullptr };
+    void (*importDestroyNotify)(void*) { nullptr };
 };
 struct wpe_audio_packet_export {
     struct wl_resource* exportResource;
@@ -89,6 +103,92 @@ GSourceFuncs ServerSource::s_sourceFuncs = {
     nullptr, // closure_marshall
 };
 
+// Checks the pending wp_viewport state against the buffer about to be committed,
+// when its size is known.
+static bool validateViewport(Surface& surface)
+{
+    const Viewport& viewport = surface.pendingViewport;
+    if (!viewport.hasSource)
+        return true;
+
+    if (!viewport.destinationWidth && (wl_fixed_to_int(viewport.sourceWidth) != wl_fixed_to_double(viewport.sourceWidth)
+        || wl_fixed_to_int(viewport.sourceHeight) != wl_fixed_to_double(viewport.sourceHeight))) {
+        wl_resource_post_error(surface.viewportResource, WP_VIEWPORT_ERROR_BAD_SIZE,
+            "the source size is not integer and no destination size is set");
+        return false;
+    }
+
+    int32_t bufferWidth = 0;
+    int32_t bufferHeight = 0;
+    if (surface.dmabufBuffer && surface.bufferResource) {
+        bufferWidth = surface.dmabufBuffer->attributes.width;
+        bufferHeight = surface.dmabufBuffer->attributes.height;
+    } else if (surface.shmBuffer && surface.bufferResource) {
+        bufferWidth = wl_shm_buffer_get_width(surface.shmBuffer);
+        bufferHeight = wl_shm_buffer_get_height(surface.shmBuffer);
+    }
+
+    if (bufferWidth && bufferHeight
+        && (viewport.sourceX + viewport.sourceWidth > wl_fixed_from_int(bufferWidth)
+            || viewport.sourceY + viewport.sourceHeight > wl_fixed_from_int(bufferHeight))) {
+        wl_resource_post_error(surface.viewportResource, WP_VIEWPORT_ERROR_OUT_OF_BUFFER,
+            "the source rectangle extends outside of the buffer");
+        return false;
+    }
+
+    return true;
+}
+
+static void commitSurface(Surface& surface)
+{
+    if (surface.synchronizationResource) {
+        bool hasPendingSync = surface.pendingAcquireFence != -1 || !wl_list_empty(&surface.pendingReleases);
+        if (hasPendingSync && !surface.bufferResource) {
+            wl_resource_post_error(surface.synchronizationResource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_BUFFER,
+                "explicit synchronization used without an attached buffer");
+            return;
+        }
+
+        bool supportsAcquireFence = !!surface.dmabufBuffer
+            || WS::Instance::singleton().impl().type() == ImplementationType::DmabufPool;
+        if (surface.pendingAcquireFence != -1 && !supportsAcquireFence) {
+            wl_resource_post_error(surface.synchronizationResource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_UNSUPPORTED_BUFFER,
+                "acquire fences are only supported for dma-buf buffers");
+            return;
+        }
+    }
+
+    if (surface.viewportResource && !validateViewport(surface))
+        return;
+
+    surface.commit();
+
+    BufferSync sync = surface.takePendingSync();
+    if (surface.apiClient && !surface.subsurface)
+        surface.apiClient->surfaceCommitted(surface.bufferResource, std::move(sync), surface.bufferState);
+    else {
+        if (sync.acquireFence != -1)
+            close(sync.acquireFence);
+        if (sync.release)
+            sendBufferRelease(sync.release, -1);
+    }
+
+    // Buffers of sub-surfaces are not exported on their own, but handed
+    // to the embedder as layers of the root surface.
+    if (surface.subsurface) {
+        surface.subsurface->commit();
+        return;
+    }
+
+    Subsurface::applyChildrenState(surface);
+    if (surface.apiClient)
+        surface.apiClient->layersChanged(surface);
+    surface.bufferAttached = false;
+    surface.pendingDamage = { };
+
+    WS::Instance::singleton().impl().surfaceCommit(surface);
+}
+
 static const struct wl_surface_interface s_surfaceInterface = {
     // destroy
     [](struct wl_client*, struct wl_resource*) { },
@@ -96,15 +196,20 @@ static const struct wl_surface_interface s_surfaceInterface = {
     [](struct wl_client*, struct wl_resource* surfaceResource, struct wl_resource* bufferResource, int32_t, int32_t)
     {
         auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        surface.attach(bufferResource);
         Instance::singleton().impl().surfaceAttach(surface, bufferResource);
     },
     // damage
-    [](struct wl_client*, struct wl_resource*, int32_t, int32_t, int32_t, int32_t) { },
+    [](struct wl_client*, struct wl_resource* surfaceResource, int32_t x, int32_t y, int32_t width, int32_t height)
+    {
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        surface.pendingDamage.unite({ x, y, width, height });
+    },
     // frame
     [](struct wl_client* client, struct wl_resource* surfaceResource, uint32_t callback)
     {
         auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
-        if (!surface.apiClient)
+        if (!surface.apiClient && !surface.subsurface && !surface.bridgeId)
             return;
 
         struct wl_resource* callbackResource = wl_resource_create(client, &wl_callback_interface, 1, callback);
@@ -120,26 +225,85 @@ static const struct wl_surface_interface s_surfaceInterface = {
         surface.addFrameCallback(callbackResource);
     },
     // set_opaque_region
-    [](struct wl_client*, struct wl_resource*, struct wl_resource*) { },
+    [](struct wl_client*, struct wl_resource* surfaceResource, struct wl_resource* regionResource)
+    {
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        if (regionResource)
+            surface.pendingOpaqueRegion = *static_cast<Region*>(wl_resource_get_user_data(regionResource));
+        else
+            surface.pendingOpaqueRegion.clear();
+    },
     // set_input_region
     [](struct wl_client*, struct wl_resource*, struct wl_resource*) { },
     // commit
     [](struct wl_client*, struct wl_resource* surfaceResource)
     {
         auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
-        surface.commit();
-        WS::Instance::singleton().impl().surfaceCommit(surface);
+
+        // The view backend registers the surface once the client tells it the
+        // bridge id, over a separate connection; commits that arrive before
+        // that are applied upon registration instead of being dropped.
+        if (!surface.apiClient && !surface.subsurface && surface.bridgeId) {
+            surface.commitDeferred = true;
+            return;
+        }
+
+        commitSurface(surface);
     },
     // set_buffer_transform
-    [](struct wl_client*, struct wl_resource*, int32_t) { },
+    [](struct wl_client*, struct wl_resource* surfaceResource, int32_t transform)
+    {
+        if (transform < WL_OUTPUT_TRANSFORM_NORMAL || transform > WL_OUTPUT_TRANSFORM_FLIPPED_270) {
+            wl_resource_post_error(surfaceResource, WL_SURFACE_ERROR_INVALID_TRANSFORM,
+                "buffer transform must be a valid transform (%d specified)", transform);
+            return;
+        }
+
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        surface.pendingBufferTransform = transform;
+    },
     // set_buffer_scale
-    [](struct wl_client*, struct wl_resource*, int32_t) { },
+    [](struct wl_client*, struct wl_resource* surfaceResource, int32_t scale)
+    {
+        if (scale < 1) {
+            wl_resource_post_error(surfaceResource, WL_SURFACE_ERROR_INVALID_SCALE,
+                "buffer scale must be at least one (%d specified)", scale);
+            return;
+        }
+
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        surface.pendingBufferScale = scale;
+    },
 #if (WAYLAND_VERSION_MAJOR > 1) || (WAYLAND_VERSION_MAJOR == 1 && WAYLAND_VERSION_MINOR >= 10)
     // damage_buffer
-    [](struct wl_client*, struct wl_resource*, int32_t, int32_t, int32_t, int32_t) { },
+    [](struct wl_client*, struct wl_resource* surfaceResource, int32_t x, int32_t y, int32_t width, int32_t height)
+    {
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        surface.pendingDamage.unite({ x, y, width, height });
+    },
 #endif
 };
 
+static const struct wl_region_interface s_regionInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // add
+    [](struct wl_client*, struct wl_resource* resource, int32_t x, int32_t y, int32_t width, int32_t height)
+    {
+        auto& region = *static_cast<Region*>(wl_resource_get_user_data(resource));
+        region.add({ x, y, width, height });
+    },
+    // subtract
+    [](struct wl_client*, struct wl_resource* resource, int32_t x, int32_t y, int32_t width, int32_t height)
+    {
+        auto& region = *static_cast<Region*>(wl_resource_get_user_data(resource));
+        region.subtract({ x, y, width, height });
+    },
+};
+
 static const struct wl_compositor_interface s_compositorInterface = {
     // create_surface
     [](struct wl_client* client, struct wl_resource* resource, uint32_t id)
@@ -157,11 +321,415 @@ static const struct wl_compositor_interface s_compositorInterface = {
             {
                 auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
                 WS::Instance::singleton().unregisterSurface(surface);
+                Subsurface::surfaceDestroyed(*surface);
                 delete surface;
             });
     },
     // create_region
-    [](struct wl_client*, struct wl_resource*, uint32_t) { },
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id)
+    {
+        struct wl_resource* regionResource = wl_resource_create(client, &wl_region_interface,
+            wl_resource_get_version(resource), id);
+        if (!regionResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(regionResource, &s_regionInterface, new Region,
+            [](struct wl_resource* resource)
+            {
+                delete static_cast<Region*>(wl_resource_get_user_data(resource));
+            });
+    },
+};
+
+static void subsurfaceChanged(Subsurface& subsurface)
+{
+    Surface& root = subsurface.root();
+    if (root.apiClient)
+        root.apiClient->layersChanged(root);
+}
+
+static const struct wl_subsurface_interface s_subsurfaceInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // set_position
+    [](struct wl_client*, struct wl_resource* resource, int32_t x, int32_t y)
+    {
+        auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+        if (!subsurface)
+            return;
+
+        subsurface->pendingPosition.x = x;
+        subsurface->pendingPosition.y = y;
+    },
+    // place_above
+    [](struct wl_client*, struct wl_resource* resource, struct wl_resource* siblingResource)
+    {
+        auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+        if (!subsurface)
+            return;
+
+        auto& sibling = *static_cast<Surface*>(wl_resource_get_user_data(siblingResource));
+        if (!Subsurface::placeAbove(*subsurface, sibling)) {
+            wl_resource_post_error(resource, WL_SUBSURFACE_ERROR_BAD_SURFACE,
+                "wl_subsurface.place_above: wl_surface@%u is not a parent or sibling", wl_resource_get_id(siblingResource));
+        }
+    },
+    // place_below
+    [](struct wl_client*, struct wl_resource* resource, struct wl_resource* siblingResource)
+    {
+        auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+        if (!subsurface)
+            return;
+
+        auto& sibling = *static_cast<Surface*>(wl_resource_get_user_data(siblingResource));
+        if (!Subsurface::placeBelow(*subsurface, sibling)) {
+            wl_resource_post_error(resource, WL_SUBSURFACE_ERROR_BAD_SURFACE,
+                "wl_subsurface.place_below: wl_surface@%u is not a parent or sibling", wl_resource_get_id(siblingResource));
+        }
+    },
+    // set_sync
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+        if (subsurface)
+            subsurface->synchronized = true;
+    },
+    // set_desync
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+        if (!subsurface || !subsurface->synchronized)
+            return;
+
+        // State cached while synchronized is applied right away.
+        subsurface->synchronized = false;
+        if (subsurface->hasCachedState && !subsurface->isSynchronized()) {
+            subsurface->applyCachedState();
+            subsurfaceChanged(*subsurface);
+        }
+    },
+};
+
+static const struct wl_subcompositor_interface s_subcompositorInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // get_subsurface
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id, struct wl_resource* surfaceResource, struct wl_resource* parentResource)
+    {
+        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        auto& parent = *static_cast<Surface*>(wl_resource_get_user_data(parentResource));
+
+        if (surface.subsurface || surface.bridgeId) {
+            wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_SURFACE,
+                "wl_subcompositor.get_subsurface: wl_surface@%u already has a role", wl_resource_get_id(surfaceResource));
+            return;
+        }
+
+        // The parent must not be the surface itself, nor one of its descendants.
+        for (Surface* ancestor = &parent; ancestor; ancestor = ancestor->subsurface ? ancestor->subsurface->parent : nullptr) {
+            if (ancestor == &surface) {
+                wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_SURFACE,
+                    "wl_subcompositor.get_subsurface: wl_surface@%u is an ancestor of the parent", wl_resource_get_id(surfaceResource));
+                return;
+            }
+        }
+
+        struct wl_resource* subsurfaceResource = wl_resource_create(client, &wl_subsurface_interface,
+            wl_resource_get_version(resource), id);
+        if (!subsurfaceResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        auto* subsurface = new Subsurface(subsurfaceResource, surface, parent);
+        wl_resource_set_implementation(subsurfaceResource, &s_subsurfaceInterface, subsurface,
+            [](struct wl_resource* resource)
+            {
+                auto* subsurface = static_cast<Subsurface*>(wl_resource_get_user_data(resource));
+                if (!subsurface)
+                    return;
+
+                Surface& root = subsurface->root();
+                bool wasMapped = !!subsurface->current.buffer.resource();
+                delete subsurface;
+
+                if (wasMapped && root.apiClient)
+                    root.apiClient->layersChanged(root);
+            });
+    },
+};
+
+static bool isValidSyncFile(int fd)
+{
+    struct sync_file_info info;
+    std::memset(&info, 0, sizeof(info));
+    return ioctl(fd, SYNC_IOC_FILE_INFO, &info) == 0 && info.num_fences > 0;
+}
+
+void sendBufferRelease(struct wl_resource* release, int releaseFence)
+{
+    if (releaseFence != -1)
+        zwp_linux_buffer_release_v1_send_fenced_release(release, releaseFence);
+    else
+        zwp_linux_buffer_release_v1_send_immediate_release(release);
+    wl_resource_destroy(release);
+}
+
+static const struct zwp_linux_surface_synchronization_v1_interface s_surfaceSynchronizationInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // set_acquire_fence
+    [](struct wl_client*, struct wl_resource* resource, int32_t fd)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+        if (!surface) {
+            close(fd);
+            wl_resource_post_error(resource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_SURFACE,
+                "the associated wl_surface was destroyed");
+            return;
+        }
+
+        if (!isValidSyncFile(fd)) {
+            close(fd);
+            wl_resource_post_error(resource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_INVALID_FENCE,
+                "the acquire fence is not a valid sync_file");
+            return;
+        }
+
+        if (surface->pendingAcquireFence != -1) {
+            close(fd);
+            wl_resource_post_error(resource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_DUPLICATE_FENCE,
+                "an acquire fence was already set for this commit");
+            return;
+        }
+
+        surface->pendingAcquireFence = fd;
+    },
+    // get_release
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+        if (!surface) {
+            wl_resource_post_error(resource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_SURFACE,
+                "the associated wl_surface was destroyed");
+            return;
+        }
+
+        if (!wl_list_empty(&surface->pendingReleases)) {
+            wl_resource_post_error(resource, ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_DUPLICATE_RELEASE,
+                "a release was already requested for this commit");
+            return;
+        }
+
+        struct wl_resource* releaseResource = wl_resource_create(client, &zwp_linux_buffer_release_v1_interface, 1, id);
+        if (!releaseResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(releaseResource, nullptr, nullptr,
+            [](struct wl_resource* resource)
+            {
+                wl_list_remove(wl_resource_get_link(resource));
+            });
+        wl_list_insert(surface->pendingReleases.prev, wl_resource_get_link(releaseResource));
+    },
+};
+
+static const struct zwp_linux_explicit_synchronization_v1_interface s_linuxExplicitSynchronizationInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // get_synchronization
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id, struct wl_resource* surfaceResource)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        if (surface->synchronizationResource) {
+            wl_resource_post_error(resource, ZWP_LINUX_EXPLICIT_SYNCHRONIZATION_V1_ERROR_SYNCHRONIZATION_EXISTS,
+                "the surface already has a synchronization object");
+            return;
+        }
+
+        struct wl_resource* synchronizationResource = wl_resource_create(client, &zwp_linux_surface_synchronization_v1_interface,
+            wl_resource_get_version(resource), id);
+        if (!synchronizationResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(synchronizationResource, &s_surfaceSynchronizationInterface, surface,
+            [](struct wl_resource* resource)
+            {
+                auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+                if (!surface)
+                    return;
+
+                // Pending fences are discarded along with the synchronization object,
+                // while release objects are kept.
+                surface->synchronizationResource = nullptr;
+                if (surface->pendingAcquireFence != -1) {
+                    close(surface->pendingAcquireFence);
+                    surface->pendingAcquireFence = -1;
+                }
+            });
+        surface->synchronizationResource = synchronizationResource;
+    },
+};
+
+static const struct wp_viewport_interface s_viewportInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // set_source
+    [](struct wl_client*, struct wl_resource* resource, wl_fixed_t x, wl_fixed_t y, wl_fixed_t width, wl_fixed_t height)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+        if (!surface) {
+            wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE,
+                "the associated wl_surface was destroyed");
+            return;
+        }
+
+        const wl_fixed_t unset = wl_fixed_from_int(-1);
+        if (x == unset && y == unset && width == unset && height == unset) {
+            surface->pendingViewport.hasSource = false;
+            return;
+        }
+
+        if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+            wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE,
+                "wp_viewport.set_source: invalid rectangle %fx%f+%f+%f",
+                wl_fixed_to_double(width), wl_fixed_to_double(height), wl_fixed_to_double(x), wl_fixed_to_double(y));
+            return;
+        }
+
+        surface->pendingViewport.hasSource = true;
+        surface->pendingViewport.sourceX = x;
+        surface->pendingViewport.sourceY = y;
+        surface->pendingViewport.sourceWidth = width;
+        surface->pendingViewport.sourceHeight = height;
+    },
+    // set_destination
+    [](struct wl_client*, struct wl_resource* resource, int32_t width, int32_t height)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+        if (!surface) {
+            wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE,
+                "the associated wl_surface was destroyed");
+            return;
+        }
+
+        if (width == -1 && height == -1) {
+            surface->pendingViewport.destinationWidth = 0;
+            surface->pendingViewport.destinationHeight = 0;
+            return;
+        }
+
+        if (width <= 0 || height <= 0) {
+            wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE,
+                "wp_viewport.set_destination: invalid size %dx%d", width, height);
+            return;
+        }
+
+        surface->pendingViewport.destinationWidth = width;
+        surface->pendingViewport.destinationHeight = height;
+    },
+};
+
+static const struct wp_viewporter_interface s_viewporterInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // get_viewport
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id, struct wl_resource* surfaceResource)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        if (surface->viewportResource) {
+            wl_resource_post_error(resource, WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS,
+                "the surface already has a viewport object");
+            return;
+        }
+
+        struct wl_resource* viewportResource = wl_resource_create(client, &wp_viewport_interface,
+            wl_resource_get_version(resource), id);
+        if (!viewportResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(viewportResource, &s_viewportInterface, surface,
+            [](struct wl_resource* resource)
+            {
+                auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+                if (!surface)
+                    return;
+
+                // Cropping and scaling are removed on the next commit.
+                surface->viewportResource = nullptr;
+                surface->pendingViewport = { };
+            });
+        surface->viewportResource = viewportResource;
+    },
+};
+
+static const struct wp_fractional_scale_v1_interface s_fractionalScaleInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+};
+
+static const struct wp_fractional_scale_manager_v1_interface s_fractionalScaleManagerInterface = {
+    // destroy
+    [](struct wl_client*, struct wl_resource* resource)
+    {
+        wl_resource_destroy(resource);
+    },
+    // get_fractional_scale
+    [](struct wl_client* client, struct wl_resource* resource, uint32_t id, struct wl_resource* surfaceResource)
+    {
+        auto* surface = static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
+        if (surface->fractionalScaleResource) {
+            wl_resource_post_error(resource, WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_FRACTIONAL_SCALE_EXISTS,
+                "the surface already has a fractional scale object");
+            return;
+        }
+
+        struct wl_resource* fractionalScaleResource = wl_resource_create(client, &wp_fractional_scale_v1_interface,
+            wl_resource_get_version(resource), id);
+        if (!fractionalScaleResource) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(fractionalScaleResource, &s_fractionalScaleInterface, surface,
+            [](struct wl_resource* resource)
+            {
+                auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+                if (surface)
+                    surface->fractionalScaleResource = nullptr;
+            });
+        surface->fractionalScaleResource = fractionalScaleResource;
+        wp_fractional_scale_v1_send_preferred_scale(fractionalScaleResource, surface->preferredScale);
+    },
 };
 
 static const struct wpe_bridge_interface s_wpeBridgeInterface = {
@@ -173,9 +741,13 @@ static const struct wpe_bridge_interface s_wpeBridgeInterface = {
         case ImplementationType::DmabufPool:
             implementationType = WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_DMABUF_POOL;
             break;
+        case ImplementationType::SHM:
+            // Older clients render through wayland-egl, which falls back to wl_shm.
+            if (wl_resource_get_version(resource) >= WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_SHM_SINCE_VERSION)
+                implementationType = WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_SHM;
+            break;
         case ImplementationType::EGL:
         case ImplementationType::EGLStream:
-        case ImplementationType::SHM:
             implementationType = WPE_BRIDGE_CLIENT_IMPLEMENTATION_TYPE_WAYLAND;
             break;
         default:
@@ -191,6 +763,16 @@ static const struct wpe_bridge_interface s_wpeBridgeInterface = {
         if (!surface)
             return;
 
+        // Each wpe_bridge and surface refer to each other at most once: a
+        // client may connect several surfaces through the same object, or a
+        // surface through several objects, and frame timing uses the last.
+        if (auto* previous = static_cast<Surface*>(wl_resource_get_user_data(resource)))
+            previous->bridgeResource = nullptr;
+        if (surface->bridgeResource)
+            wl_resource_set_user_data(surface->bridgeResource, nullptr);
+        wl_resource_set_user_data(resource, surface);
+        surface->bridgeResource = resource;
+
         static uint32_t bridgeID = 0;
         ++bridgeID;
         wpe_bridge_send_connected(resource, bridgeID);
@@ -224,32 +806,37 @@ static const struct wpe_dmabuf_data_interface s_wpeDmabufDataInterface = {
     },
 };
 
+static void createDmabufPoolBuffer(struct wl_client* client, struct wl_resource* resource, uint32_t id, uint32_t width, uint32_t height, uint32_t format)
+{
+    auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(resource));
+    auto entry = WS::Instance::singleton().impl().createDmabufPoolEntry(surface, width, height, format);
+    if (!entry) {
+        // FIXME: more of an error
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+
+    struct wl_resource* bufferResource = wl_resource_create(client, &wl_buffer_interface,
+        wl_resource_get_version(resource), id);
+    if (!bufferResource) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+
+    entry->bufferResource = bufferResource;
+    wl_resource_set_implementation(bufferResource, &s_wpeDmabufPoolEntryBufferInterface, entry,
+        [](struct wl_resource* resource)
+        {
+            auto* entry = static_cast<struct wpe_dmabuf_pool_entry*>(wl_resource_get_user_data(resource));
+            entry->bufferResource = nullptr;
+        });
+}
+
 static const struct wpe_dmabuf_pool_interface s_wpeDmabufPoolInterface = {
     // create_buffer
     [](struct wl_client* client, struct wl_resource* resource, uint32_t id, uint32_t width, uint32_t height)
     {
-        auto& surface = *static_cast<Surface*>(wl_resource_get_user_data(resource));
-        auto entry = WS::Instance::singleton().impl().createDmabufPoolEntry(surface);
-        if (!entry) {
-            // FIXME: more of an error
-            wl_resource_post_no_memory(resource);
-            return;
-        }
-
-        struct wl_resource* bufferResource = wl_resource_create(client, &wl_buffer_interface,
-            wl_resource_get_version(resource), id);
-        if (!bufferResource) {
-            wl_resource_post_no_memory(resource);
-            return;
-        }
-
-        entry->bufferResource = bufferResource;
-        wl_resource_set_implementation(bufferResource, &s_wpeDmabufPoolEntryBufferInterface, entry,
-            [](struct wl_resource* resource)
-            {
-                auto* entry = static_cast<struct wpe_dmabuf_pool_entry*>(wl_resource_get_user_data(resource));
-                entry->bufferResource = nullptr;
-            });
+        createDmabufPoolBuffer(client, resource, id, width, height, 0);
     },
     // get_dmabuf_data
     [](struct wl_client* client, struct wl_resource* resource, uint32_t id, struct wl_resource* bufferResource)
@@ -267,6 +854,8 @@ static const struct wpe_dmabuf_pool_interface s_wpeDmabufPoolInterface = {
 
         wl_resource_set_implementation(dmabufDataResource, &s_wpeDmabufDataInterface, entry, nullptr);
     },
+    // create_buffer_with_format
+    createDmabufPoolBuffer,
 };
 
 static const struct wpe_dmabuf_pool_manager_interface s_wpeDmabufPoolManagerInterface = {
@@ -281,7 +870,12 @@ static const struct wpe_dmabuf_pool_manager_interface s_wpeDmabufPoolManagerInte
         }
 
         auto* surface = static_cast<Surface*>(wl_resource_get_user_data(surfaceResource));
-        wl_resource_set_implementation(poolResource, &s_wpeDmabufPoolInterface, surface, nullptr);
+        wl_resource_set_implementation(poolResource, &s_wpeDmabufPoolInterface, surface,
+            [](struct wl_resource* resource)
+            {
+                wl_list_remove(wl_resource_get_link(resource));
+            });
+        WS::Instance::singleton().addDmabufPool(poolResource);
     },
 };
 
@@ -416,7 +1010,13 @@ Instance::Instance(std::unique_ptr<Impl>&& impl)
 {
     m_impl->setInstance(*this);
 
-    m_compositor = wl_global_create(m_display, &wl_compositor_interface, 3, this,
+    // Version 4 adds wl_surface.damage_buffer.
+#if (WAYLAND_VERSION_MAJOR > 1) || (WAYLAND_VERSION_MAJOR == 1 && WAYLAND_VERSION_MINOR >= 10)
+    const int compositorVersion = 4;
+#else
+    const int compositorVersion = 3;
+#endif
+    m_compositor = wl_global_create(m_display, &wl_compositor_interface, compositorVersion, this,
         [](struct wl_client* client, void*, uint32_t version, uint32_t id)
         {
             struct wl_resource* resource = wl_resource_create(client, &wl_compositor_interface, version, id);
@@ -427,7 +1027,18 @@ Instance::Instance(std::unique_ptr<Impl>&& impl)
 
             wl_resource_set_implementation(resource, &s_compositorInterface, nullptr, nullptr);
         });
-    m_wpeBridge = wl_global_create(m_display, &wpe_bridge_interface, 1, this,
+    m_subcompositor = wl_global_create(m_display, &wl_subcompositor_interface, 1, this,
+        [](struct wl_client* client, void*, uint32_t version, uint32_t id)
+        {
+            struct wl_resource* resource = wl_resource_create(client, &wl_subcompositor_interface, version, id);
+            if (!resource) {
+                wl_client_post_no_memory(client);
+                return;
+            }
+
+            wl_resource_set_implementation(resource, &s_subcompositorInterface, nullptr, nullptr);
+        });
+    m_wpeBridge = wl_global_create(m_display, &wpe_bridge_interface, 3, this,
         [](struct wl_client* client, void*, uint32_t version, uint32_t id)
         {
             struct wl_resource* resource = wl_resource_create(client, &wpe_bridge_interface, version, id);
@@ -436,9 +1047,16 @@ Instance::Instance(std::unique_ptr<Impl>&& impl)
                 return;
             }
 
-            wl_resource_set_implementation(resource, &s_wpeBridgeInterface, nullptr, nullptr);
+            wl_resource_set_implementation(resource, &s_wpeBridgeInterface, nullptr,
+                [](struct wl_resource* resource)
+                {
+                    auto* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+                    if (surface)
+                        surface->bridgeResource = nullptr;
+                });
         });
-    m_wpeDmabufPoolManager = wl_global_create(m_display, &wpe_dmabuf_pool_manager_interface, 1, this,
+    wl_list_init(&m_dmabufPoolResources);
+    m_wpeDmabufPoolManager = wl_global_create(m_display, &wpe_dmabuf_pool_manager_interface, 3, this,
         [](struct wl_client* client, void*, uint32_t version, uint32_t id)
         {
             struct wl_resource* resource = wl_resource_create(client, &wpe_dmabuf_pool_manager_interface, version, id);
@@ -449,6 +1067,53 @@ Instance::Instance(std::unique_ptr<Impl>&& impl)
 
             wl_resource_set_implementation(resource, &s_wpeDmabufPoolManagerInterface, nullptr, nullptr);
         });
+    m_linuxExplicitSynchronization = wl_global_create(m_display, &zwp_linux_explicit_synchronization_v1_interface, 2, this,
+        [](struct wl_client* client, void*, uint32_t version, uint32_t id)
+        {
+            struct wl_resource* resource = wl_resource_create(client, &zwp_linux_explicit_synchronization_v1_interface, version, id);
+            if (!resource) {
+                wl_client_post_no_memory(client);
+                return;
+            }
+
+            wl_resource_set_implementation(resource, &s_linuxExplicitSynchronizationInterface, nullptr, nullptr);
+        });
+    // Views are advertised as outputs only to the client they belong to.
+#if (WAYLAND_VERSION_MAJOR > 1) || (WAYLAND_VERSION_MAJOR == 1 && WAYLAND_VERSION_MINOR >= 13)
+    wl_display_set_global_filter(m_display,
+        [](const struct wl_client* client, const struct wl_global* global, void* data) -> bool
+        {
+            auto& instance = *static_cast<Instance*>(data);
+            auto it = instance.m_outputClients.find(global);
+            if (it != instance.m_outputClients.end())
+                return it->second == client;
+
+            // The output of a view is announced while it is being created.
+            return !instance.m_outputClientPending || instance.m_outputClientPending == client;
+        }, this);
+#endif
+    m_viewporter = wl_global_create(m_display, &wp_viewporter_interface, 1, this,
+        [](struct wl_client* client, void*, uint32_t version, uint32_t id)
+        {
+            struct wl_resource* resource = wl_resource_create(client, &wp_viewporter_interface, version, id);
+            if (!resource) {
+                wl_client_post_no_memory(client);
+                return;
+            }
+
+            wl_resource_set_implementation(resource, &s_viewporterInterface, nullptr, nullptr);
+        });
+    m_fractionalScaleManager = wl_global_create(m_display, &wp_fractional_scale_manager_v1_interface, 1, this,
+        [](struct wl_client* client, void*, uint32_t version, uint32_t id)
+        {
+            struct wl_resource* resource = wl_resource_create(client, &wp_fractional_scale_manager_v1_interface, version, id);
+            if (!resource) {
+                wl_client_post_no_memory(client);
+                return;
+            }
+
+            wl_resource_set_implementation(resource, &s_fractionalScaleManagerInterface, nullptr, nullptr);
+        });
 
     auto& source = *reinterpret_cast<ServerSource*>(m_source);
 
@@ -476,12 +1141,24 @@ Instance::~Instance()
     if (m_compositor)
         wl_global_destroy(m_compositor);
 
+    if (m_subcompositor)
+        wl_global_destroy(m_subcompositor);
+
     if (m_wpeBridge)
         wl_global_destroy(m_wpeBridge);
 
     if (m_wpeDmabufPoolManager)
         wl_global_destroy(m_wpeDmabufPoolManager);
 
+    if (m_linuxExplicitSynchronization)
+        wl_global_destroy(m_linuxExplicitSynchronization);
+
+    if (m_viewporter)
+        wl_global_destroy(m_viewporter);
+
+    if (m_fractionalScaleManager)
+        wl_global_destroy(m_fractionalScaleManager);
+
     if (m_videoPlaneDisplayDmaBuf.object)
         wl_global_destroy(m_videoPlaneDisplayDmaBuf.object);
 
@@ -510,9 +1187,18 @@ int Instance::createClient()
 
 void Instance::registerSurface(uint32_t id, Surface* surface)
 {
+    surface->bridgeId = id;
     m_viewBackendMap.insert({ id, surface });
 }
 
+Surface* Instance::surfaceForBridge(uint32_t bridgeId)
+{
+    auto it = m_viewBackendMap.find(bridgeId);
+    if (it == m_viewBackendMap.end())
+        return nullptr;
+    return it->second;
+}
+
 void Instance::initializeVideoPlaneDisplayDmaBuf(VideoPlaneDisplayDmaBufCallback updateCallback, VideoPlaneDisplayDmaBufEndOfStreamCallback endOfStreamCallback)
 {
     if (m_videoPlaneDisplayDmaBuf.object)
@@ -541,7 +1227,14 @@ void Instance::handleVideoPlaneDisplayDmaBuf(struct wpe_video_plane_display_dmab
         return;
     }
 
+    // Only the first plane is transferred, with no offset and without modifiers.
+    uint32_t offset = 0;
+    dmabuf_export->cacheable = fd >= 0 && DmabufImportCache::computeKey(dmabuf_export->key,
+        width, height, 0, 1, &fd, &offset, &stride, nullptr);
+    dmabuf_export->fd = fd;
+
     m_videoPlaneDisplayDmaBuf.updateCallback(dmabuf_export, id, fd, x, y, width, height, stride);
+    dmabuf_export->fd = -1;
 }
 
 void Instance::handleVideoPlaneDisplayDmaBufEndOfStream(uint32_t id)
@@ -554,9 +1247,49 @@ void Instance::handleVideoPlaneDisplayDmaBufEndOfStream(uint32_t id)
 
 void Instance::releaseVideoPlaneDisplayDmaBufExport(struct wpe_video_plane_display_dmabuf_export* dmabuf_export)
 {
+    if (dmabuf_export->import) {
+        if (!m_videoPlaneDisplayDmaBuf.importCache.release(dmabuf_export->import) && dmabuf_export->importDestroyNotify)
+            dmabuf_export->importDestroyNotify(dmabuf_export->import);
+        dmabuf_export->import = nullptr;
+    }
+
     wpe_video_plane_display_dmabuf_update_send_release(dmabuf_export->updateResource);
 }
 
+void* Instance::videoPlaneDisplayDmaBufImport(struct wpe_video_plane_display_dmabuf_export* dmabuf_export)
+{
+    if (!dmabuf_export->import && dmabuf_export->cacheable)
+        dmabuf_export->import = m_videoPlaneDisplayDmaBuf.importCache.acquire(dmabuf_export->key);
+    return dmabuf_export->import;
+}
+
+void Instance::setVideoPlaneDisplayDmaBufImport(struct wpe_video_plane_display_dmabuf_export* dmabuf_export, void* import, void (*destroyNotify)(void*))
+{
+    if (!import)
+        return;
+
+    if (dmabuf_export->import) {
+        g_warning("Instance::setVideoPlaneDisplayDmaBufImport(): export already has an associated import.");
+        if (destroyNotify)
+            destroyNotify(import);
+        return;
+    }
+
+    dmabuf_export->import = import;
+    dmabuf_export->importDestroyNotify = destroyNotify;
+
+    // The file descriptor is only guaranteed to be valid while the receiver's
+    // handle_dmabuf callback runs, so imports can only be cached from there.
+    if (dmabuf_export->cacheable && dmabuf_export->fd != -1) {
+        // If this fails the import stays owned by the export, see releaseVideoPlaneDisplayDmaBufExport().
+        m_videoPlaneDisplayDmaBuf.importCache.insert(dmabuf_export->key, import, &dmabuf_export->fd,
+            [destroyNotify](void* cachedImport) {
+                if (destroyNotify)
+                    destroyNotify(cachedImport);
+            });
+    }
+}
+
 
 void Instance::initializeAudio(AudioStartCallback startCallback, AudioPacketCallback packetCallback, AudioStopCallback stopCallback, AudioPauseCallback pauseCallback, AudioResumeCallback resumeCallback)
 {
@@ -633,7 +1366,12 @@ void Instance::registerViewBackend(uint32_t bridgeId, APIClient& apiClient)
     if (it == m_viewBackendMap.end())
         g_error("Instance::registerViewBackend(): " "Cannot find surface with bridgeId %" PRIu32 " in view backend map.", bridgeId);
 
-    it->second->apiClient = &apiClient;
+    auto& surface = *it->second;
+    surface.apiClient = &apiClient;
+    if (surface.commitDeferred) {
+        surface.commitDeferred = false;
+        commitSurface(surface);
+    }
 }
 
 void Instance::unregisterViewBackend(uint32_t bridgeId)
@@ -647,6 +1385,19 @@ void Instance::unregisterViewBackend(uint32_t bridgeId)
 
 void Instance::unregisterSurface(Surface* surface)
 {
+    if (surface->outputGlobal) {
+        m_outputClients.erase(surface->outputGlobal);
+        g_clear_pointer(&surface->outputGlobal, wl_global_destroy);
+
+        // Bound outputs outlive the global, but not the list they are in.
+        struct wl_resource* output;
+        struct wl_resource* tmp;
+        wl_resource_for_each_safe(output, tmp, &surface->outputResources) {
+            wl_list_remove(wl_resource_get_link(output));
+            wl_list_init(wl_resource_get_link(output));
+        }
+    }
+
     auto it = std::find_if(m_viewBackendMap.begin(), m_viewBackendMap.end(),
         [surface](const std::pair<uint32_t, Surface*>& value) -> bool {
             return value.second == surface;
@@ -659,6 +1410,103 @@ void Instance::unregisterSurface(Surface* surface)
     }
 }
 
+void Instance::bindOutput(Surface& surface, struct wl_resource* output)
+{
+    wl_list_insert(surface.outputResources.prev, wl_resource_get_link(output));
+
+    sendOutputProperties(output, surface.outputScale, surface.outputTransform);
+    wl_surface_send_enter(surface.resource, output);
+}
+
+void Instance::sendOutputProperties(struct wl_resource* output, int32_t scale, int32_t transform)
+{
+    wl_output_send_geometry(output, 0, 0, 0, 0, WL_OUTPUT_SUBPIXEL_UNKNOWN, "WPE", "WPEBackend-fdo", transform);
+    if (wl_resource_get_version(output) >= WL_OUTPUT_SCALE_SINCE_VERSION)
+        wl_output_send_scale(output, scale);
+    if (wl_resource_get_version(output) >= WL_OUTPUT_DONE_SINCE_VERSION)
+        wl_output_send_done(output);
+}
+
+void Instance::setOutputProperties(Surface& surface, int32_t scale, int32_t transform)
+{
+    bool changed = scale != surface.outputScale || transform != surface.outputTransform;
+    surface.outputScale = scale;
+    surface.outputTransform = transform;
+
+    // Every view acts as an output of its own, so that a client rendering
+    // several views gets the properties of each one; the surface enters it
+    // as soon as the client binds it.
+    if (!surface.outputGlobal) {
+        struct wl_client* client = wl_resource_get_client(surface.resource);
+        m_outputClientPending = client;
+        surface.outputGlobal = wl_global_create(m_display, &wl_output_interface, 2, &surface,
+            [](struct wl_client* client, void* data, uint32_t version, uint32_t id)
+            {
+                struct wl_resource* resource = wl_resource_create(client, &wl_output_interface, version, id);
+                if (!resource) {
+                    wl_client_post_no_memory(client);
+                    return;
+                }
+
+                wl_resource_set_implementation(resource, nullptr, nullptr,
+                    [](struct wl_resource* resource)
+                    {
+                        wl_list_remove(wl_resource_get_link(resource));
+                    });
+                WS::Instance::singleton().bindOutput(*static_cast<Surface*>(data), resource);
+            });
+        m_outputClientPending = nullptr;
+
+        if (surface.outputGlobal)
+            m_outputClients[surface.outputGlobal] = client;
+        return;
+    }
+
+    if (!changed)
+        return;
+
+    struct wl_resource* output;
+    wl_resource_for_each(output, &surface.outputResources)
+        sendOutputProperties(output, scale, transform);
+}
+
+void Instance::sendFrameTiming(Surface& surface, uint64_t refreshInterval, uint64_t presentationTime, uint64_t deadline)
+{
+    struct wl_resource* bridge = surface.bridgeResource;
+    if (!bridge || wl_resource_get_version(bridge) < WPE_BRIDGE_FRAME_TIMING_SINCE_VERSION)
+        return;
+
+    wpe_bridge_send_frame_timing(bridge, std::min<uint64_t>(refreshInterval, UINT32_MAX),
+        presentationTime >> 32, presentationTime & 0xffffffff, deadline >> 32, deadline & 0xffffffff);
+    wl_client_flush(wl_resource_get_client(bridge));
+}
+
+void Instance::addDmabufPool(struct wl_resource* pool)
+{
+    wl_list_insert(m_dmabufPoolResources.prev, wl_resource_get_link(pool));
+}
+
+void Instance::trimMemory(TrimMemoryLevel level)
+{
+    // View backends go first, as the images they drop may end up idle in
+    // the import caches of the implementation.
+    for (auto& it : m_viewBackendMap) {
+        if (it.second->apiClient)
+            it.second->apiClient->trimMemory(level);
+    }
+
+    m_impl->trimMemory(level);
+    m_videoPlaneDisplayDmaBuf.importCache.trim();
+
+    uint32_t poolLevel = level == TrimMemoryLevel::Critical
+        ? WPE_DMABUF_POOL_TRIM_LEVEL_CRITICAL : WPE_DMABUF_POOL_TRIM_LEVEL_MODERATE;
+    struct wl_resource* pool;
+    wl_resource_for_each(pool, &m_dmabufPoolResources) {
+        if (wl_resource_get_version(pool) >= WPE_DMABUF_POOL_TRIM_SINCE_VERSION)
+            wpe_dmabuf_pool_send_trim(pool, poolLevel);
+    }
+}
+
 bool Instance::dispatchFrameCallbacks(uint32_t bridgeId)
 {
     auto it = m_viewBackendMap.find(bridgeId);
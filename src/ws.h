@@ -25,11 +25,18 @@
 
 #pragma once
 
+#include "fractional-scale-v1-server-protocol.h"
+#include "ws-dmabuf-import-cache.h"
+#include "ws-region.h"
+#include "ws-tracing.h"
 #include "ws-types.h"
+#include <array>
 #include <functional>
 #include <glib.h>
 #include <memory>
+#include <unistd.h>
 #include <unordered_map>
+#include <vector>
 #include <wayland-server.h>
 
 struct linux_dmabuf_buffer;
@@ -39,6 +46,44 @@ struct wpe_audio_packet_export;
 
 namespace WS {
 
+// Explicit synchronization state applied with a wl_surface.commit, as set
+// through zwp_linux_surface_synchronization_v1. The acquire fence fd and the
+// zwp_linux_buffer_release_v1 resource are owned by whoever holds the struct.
+struct BufferSync {
+    int acquireFence { -1 };
+    struct wl_resource* release { nullptr };
+};
+
+// Sends the release event on a zwp_linux_buffer_release_v1 resource, which is
+// then destroyed. The fence is sent as fenced_release when valid, otherwise as
+// immediate_release; the fd is not closed.
+void sendBufferRelease(struct wl_resource* release, int releaseFence);
+
+// wp_viewport state. The source rectangle is in buffer coordinates, and the
+// destination size is zero when unset.
+struct Viewport {
+    bool hasSource { false };
+    wl_fixed_t sourceX { 0 };
+    wl_fixed_t sourceY { 0 };
+    wl_fixed_t sourceWidth { 0 };
+    wl_fixed_t sourceHeight { 0 };
+    int32_t destinationWidth { 0 };
+    int32_t destinationHeight { 0 };
+};
+
+// Double-buffered surface state which describes how the buffer of a commit is
+// to be presented, handed to the embedder along with the exported buffer.
+struct BufferState {
+    int32_t bufferScale { 1 };
+    int32_t bufferTransform { WL_OUTPUT_TRANSFORM_NORMAL };
+    Viewport viewport;
+    // In surface coordinates.
+    Region opaqueRegion;
+};
+
+struct Surface;
+struct Subsurface;
+
 struct APIClient {
     virtual ~APIClient() = default;
 
@@ -47,9 +92,22 @@ struct APIClient {
     virtual void exportShmBuffer(struct wl_resource*, struct wl_shm_buffer*) = 0;
     virtual void exportEGLStreamProducer(struct wl_resource*) = 0;
 
-    virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry() = 0;
+    virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(uint32_t width, uint32_t height, uint32_t format) = 0;
     virtual void commitDmabufPoolEntry(struct wpe_dmabuf_pool_entry*) = 0;
 
+    // Invoked for every wl_surface.commit request, before the buffer is exported,
+    // with the committed buffer, if any. The explicit synchronization state of
+    // the commit is handed over as well.
+    virtual void surfaceCommitted(struct wl_resource* buffer, BufferSync&&, const BufferState&) = 0;
+
+    // Invoked when the sub-surfaces below the surface change in a way visible
+    // to the embedder: buffers, positions or stacking order.
+    virtual void layersChanged(Surface&) = 0;
+
+    // Invoked when the embedder asks to release memory. Cached resources which
+    // can be recreated on demand should be dropped.
+    virtual void trimMemory(TrimMemoryLevel) = 0;
+
     // Invoked when the association with the surface associated with a given
     // wpe_bridge identifier is no longer valid, typically due to the nested
     // compositor client being disconnected before having the chance to read
@@ -63,6 +121,11 @@ struct Surface {
     {
         wl_list_init(&m_pendingFrameCallbacks);
         wl_list_init(&m_currentFrameCallbacks);
+        wl_list_init(&pendingReleases);
+        wl_list_init(&outputResources);
+
+        pendingStack.push_back(this);
+        stack.push_back(this);
     }
 
     ~Surface()
@@ -73,22 +136,139 @@ struct Surface {
             wl_resource_destroy(resource);
         wl_resource_for_each_safe(resource, tmp, &m_currentFrameCallbacks)
             wl_resource_destroy(resource);
+
+        if (synchronizationResource)
+            wl_resource_set_user_data(synchronizationResource, nullptr);
+        if (viewportResource)
+            wl_resource_set_user_data(viewportResource, nullptr);
+        if (fractionalScaleResource)
+            wl_resource_set_user_data(fractionalScaleResource, nullptr);
+        if (bridgeResource)
+            wl_resource_set_user_data(bridgeResource, nullptr);
+        if (pendingAcquireFence != -1)
+            close(pendingAcquireFence);
+        wl_resource_for_each_safe(resource, tmp, &pendingReleases)
+            sendBufferRelease(resource, -1);
     }
 
     struct wl_resource* resource;
 
     APIClient* apiClient { nullptr };
+    uint32_t bridgeId { 0 };
+    // wpe_bridge the surface was connected through, used to send frame timing.
+    struct wl_resource* bridgeResource { nullptr };
+    // Whether a commit is waiting for the view backend to register the surface.
+    bool commitDeferred { false };
 
     struct wl_resource* bufferResource { nullptr };
     const struct linux_dmabuf_buffer* dmabufBuffer { nullptr };
     struct wl_shm_buffer* shmBuffer { nullptr };
 
+    // Set when wl_surface.attach was requested since the last commit, even
+    // for a null buffer, which unmaps sub-surfaces.
+    bool bufferAttached { false };
+    Rect pendingDamage;
+    Region pendingOpaqueRegion;
+
+    // wl_subsurface role, if any. The stacks list the sub-surfaces of this
+    // surface bottom to top, including the surface itself; the pending one
+    // becomes current when the surface is committed.
+    Subsurface* subsurface { nullptr };
+    std::vector<Surface*> pendingStack;
+    std::vector<Surface*> stack;
+
+    // wl_surface.set_buffer_scale and set_buffer_transform state, which
+    // becomes part of bufferState on commit.
+    int32_t pendingBufferScale { 1 };
+    int32_t pendingBufferTransform { WL_OUTPUT_TRANSFORM_NORMAL };
+
+    // Scale and transform of the view, as advertised through the wl_output
+    // global of the view, which only exists once the surface is registered.
+    int32_t outputScale { 1 };
+    int32_t outputTransform { WL_OUTPUT_TRANSFORM_NORMAL };
+    struct wl_global* outputGlobal { nullptr };
+    struct wl_list outputResources;
+
+    // wp_viewport state, which becomes part of bufferState on commit.
+    struct wl_resource* viewportResource { nullptr };
+    Viewport pendingViewport;
+    BufferState bufferState;
+
+    // wp_fractional_scale_v1, and the scale to suggest through it in 1/120
+    // units, as hinted by the embedder.
+    struct wl_resource* fractionalScaleResource { nullptr };
+    uint32_t preferredScale { 120 };
+
+    void setPreferredScale(uint32_t scale)
+    {
+        if (scale == preferredScale)
+            return;
+
+        preferredScale = scale;
+        if (fractionalScaleResource)
+            wp_fractional_scale_v1_send_preferred_scale(fractionalScaleResource, preferredScale);
+    }
+
+    // zwp_linux_surface_synchronization_v1 state. Release resources stay in
+    // the list until the commit, and remove themselves when destroyed.
+    struct wl_resource* synchronizationResource { nullptr };
+    int pendingAcquireFence { -1 };
+    struct wl_list pendingReleases;
+
+    BufferSync takePendingSync()
+    {
+        BufferSync sync;
+        sync.acquireFence = pendingAcquireFence;
+        pendingAcquireFence = -1;
+
+        if (!wl_list_empty(&pendingReleases)) {
+            sync.release = wl_resource_from_link(pendingReleases.next);
+            wl_list_remove(wl_resource_get_link(sync.release));
+            wl_list_init(wl_resource_get_link(sync.release));
+        }
+        return sync;
+    }
+
+    // Number of commits so far, which matches the frame sequence number
+    // kept by the client side in BaseTarget.
+    uint64_t frameSequence { 0 };
+
+    void attach(struct wl_resource* bufferResource)
+    {
+        WS_TRACE_MARK("surfaceAttach", bridgeId, frameSequence + 1);
+        bufferAttached = true;
+        if (!bufferResource)
+            return;
+
+        auto& entry = m_attachedBuffers[m_attachedBuffersIndex++ % m_attachedBuffers.size()];
+        entry.resource = bufferResource;
+        entry.frame = frameSequence + 1;
+    }
+
     void commit()
     {
+        ++frameSequence;
+        WS_TRACE_MARK("surfaceCommit", bridgeId, frameSequence);
+
+        bufferState.bufferScale = pendingBufferScale;
+        bufferState.bufferTransform = pendingBufferTransform;
+        bufferState.viewport = pendingViewport;
+        bufferState.opaqueRegion = pendingOpaqueRegion;
+
         wl_list_insert_list(&m_currentFrameCallbacks, &m_pendingFrameCallbacks);
         wl_list_init(&m_pendingFrameCallbacks);
     }
 
+    // Frame in which a buffer was last attached, if it was among the most recent ones.
+    uint64_t frameForBuffer(struct wl_resource* bufferResource) const
+    {
+        for (auto& entry : m_attachedBuffers) {
+            if (entry.resource == bufferResource)
+                return entry.frame;
+        }
+        return 0;
+    }
+
     void addFrameCallback(struct wl_resource* resource)
     {
         wl_list_insert(m_pendingFrameCallbacks.prev, wl_resource_get_link(resource));
@@ -96,27 +276,46 @@ struct Surface {
 
     bool dispatchFrameCallbacks()
     {
+        if (!sendFrameCallbacks())
+            return false;
+
+        WS_TRACE_MARK("dispatchFrameCallbacks", bridgeId, frameSequence);
+        wl_client_flush(wl_resource_get_client(resource));
+        return true;
+    }
+
+private:
+    // Sends the frame callbacks of the surface and its sub-surfaces, which
+    // all belong to the same client, stamped with the monotonic time in ms.
+    bool sendFrameCallbacks()
+    {
+        bool sent = false;
+        uint32_t time = g_get_monotonic_time() / 1000;
+
         struct wl_resource* resource;
         struct wl_resource* tmp;
-        struct wl_client* client { nullptr };
-
         wl_resource_for_each_safe(resource, tmp, &m_currentFrameCallbacks) {
-            g_assert(!client || client == wl_resource_get_client(resource));
-            client = wl_resource_get_client(resource);
-            wl_callback_send_done(resource, 0);
+            wl_callback_send_done(resource, time);
             wl_resource_destroy(resource);
+            sent = true;
         }
 
-        if (!client)
-            return false;
-
-        wl_client_flush(client);
-        return true;
+        for (auto* child : stack) {
+            if (child != this)
+                sent |= child->sendFrameCallbacks();
+        }
+        return sent;
     }
 
-private:
     struct wl_list m_pendingFrameCallbacks;
     struct wl_list m_currentFrameCallbacks;
+
+    struct AttachedBuffer {
+        struct wl_resource* resource { nullptr };
+        uint64_t frame { 0 };
+    };
+    std::array<AttachedBuffer, 4> m_attachedBuffers;
+    unsigned m_attachedBuffersIndex { 0 };
 };
 
 class Instance {
@@ -135,7 +334,9 @@ public:
         virtual void surfaceAttach(Surface&, struct wl_resource*) = 0;
         virtual void surfaceCommit(Surface&) = 0;
 
-        virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&) = 0;
+        virtual struct wpe_dmabuf_pool_entry* createDmabufPoolEntry(Surface&, uint32_t width, uint32_t height, uint32_t format) = 0;
+
+        virtual void trimMemory(TrimMemoryLevel) { }
 
     private:
         Instance* m_instance { nullptr };
@@ -152,16 +353,32 @@ public:
 
     void registerSurface(uint32_t, Surface*);
     void unregisterSurface(Surface*);
+    Surface* surfaceForBridge(uint32_t);
     void registerViewBackend(uint32_t, APIClient&);
     void unregisterViewBackend(uint32_t);
     bool dispatchFrameCallbacks(uint32_t);
 
+    // Advertises the scale and transform of the view a surface belongs to,
+    // through a wl_output global of its own which the surface enters.
+    void setOutputProperties(Surface&, int32_t scale, int32_t transform);
+    // Sends the display timing of the view to the client of a surface, if
+    // it bound wpe_bridge with frame timing support. Times are in nanoseconds.
+    void sendFrameTiming(Surface&, uint64_t refreshInterval, uint64_t presentationTime, uint64_t deadline);
+
+    void addDmabufPool(struct wl_resource*);
+
+    // Drops cached graphics resources in the compositor, and asks the clients
+    // to release the buffers they are not using.
+    void trimMemory(TrimMemoryLevel);
+
     using VideoPlaneDisplayDmaBufCallback = std::function<void(struct wpe_video_plane_display_dmabuf_export*, uint32_t, int, int32_t, int32_t, int32_t, int32_t, uint32_t)>;
     using VideoPlaneDisplayDmaBufEndOfStreamCallback = std::function<void(uint32_t)>;
     void initializeVideoPlaneDisplayDmaBuf(VideoPlaneDisplayDmaBufCallback, VideoPlaneDisplayDmaBufEndOfStreamCallback);
     void handleVideoPlaneDisplayDmaBuf(struct wpe_video_plane_display_dmabuf_export*, uint32_t id, int fd, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t stride);
     void handleVideoPlaneDisplayDmaBufEndOfStream(uint32_t id);
     void releaseVideoPlaneDisplayDmaBufExport(struct wpe_video_plane_display_dmabuf_export*);
+    void* videoPlaneDisplayDmaBufImport(struct wpe_video_plane_display_dmabuf_export*);
+    void setVideoPlaneDisplayDmaBufImport(struct wpe_video_plane_display_dmabuf_export*, void* import, void (*destroyNotify)(void*));
 
     using AudioStartCallback = std::function<void(uint32_t, int32_t, const char*, int32_t)>;
     using AudioPacketCallback = std::function<void(struct wpe_audio_packet_export*, uint32_t, int32_t, uint32_t)>;
@@ -181,12 +398,23 @@ private:
 
     Instance(std::unique_ptr<Impl>&&);
 
+    void bindOutput(Surface&, struct wl_resource*);
+    static void sendOutputProperties(struct wl_resource* output, int32_t scale, int32_t transform);
+
     std::unique_ptr<Impl> m_impl;
 
     struct wl_display* m_display { nullptr };
     struct wl_global* m_compositor { nullptr };
+    struct wl_global* m_subcompositor { nullptr };
     struct wl_global* m_wpeBridge { nullptr };
     struct wl_global* m_wpeDmabufPoolManager { nullptr };
+    struct wl_global* m_linuxExplicitSynchronization { nullptr };
+    struct wl_global* m_viewporter { nullptr };
+    struct wl_global* m_fractionalScaleManager { nullptr };
+    // (wl_output global of a view -> client of the view)
+    std::unordered_map<const struct wl_global*, const struct wl_client*> m_outputClients;
+    const struct wl_client* m_outputClientPending { nullptr };
+    struct wl_list m_dmabufPoolResources;
     GSource* m_source { nullptr };
 
     // (bridgeId -> Surface)
@@ -196,6 +424,7 @@ private:
         struct wl_global* object { nullptr };
         VideoPlaneDisplayDmaBufCallback updateCallback;
         VideoPlaneDisplayDmaBufEndOfStreamCallback endOfStreamCallback;
+        DmabufImportCache importCache { 16 };
     } m_videoPlaneDisplayDmaBuf;
 
     struct {